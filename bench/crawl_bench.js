@@ -0,0 +1,268 @@
+// End-to-end crawl benchmark. Runs the crawler back to back (no crawl
+// interval) against the fixture server and reports throughput, parsing and
+// memory figures as JSON.
+//
+// Usage:
+//   node --expose-gc bench/crawl_bench.js [--duration 60] [--rolls 200000]
+//       [--characters 2000] [--missing 0.001] [--padding 0] [--latency 50]
+//       [--latency-variance 0] [--fixtures dir] [--base-url url]
+//       [--policy gaps|lowest]
+//
+// The gaps policy picks IDs with the crawler's GapScheduler, the lowest policy
+// always crawls the lowest missing ID as the crawler used to.
+//
+// Without --base-url a fixture server is forked with the remaining options so
+// its CPU time is not counted against the crawler.
+const { fork } = require('child_process');
+const path = require('path');
+
+const {
+  crawl,
+  toIDTypedArray,
+  my_addon,
+  RollNotFoundError,
+} = require('../src/module.js');
+const { GapScheduler } = require('../src/scheduler.js');
+
+function handleCLIArgs(argv) {
+  const minimist = require('minimist');
+  const args = minimist(argv, {
+    string: ['base-url', 'fixtures', 'policy'],
+    default: {
+      policy: 'gaps',
+      duration: 60,
+      'sample-every': 10,
+      rolls: 200000,
+      characters: 2000,
+      missing: 0.001,
+      padding: 0,
+      latency: 50,
+      'latency-variance': 0,
+    },
+  });
+
+  const server_args = [];
+  [
+    'rolls',
+    'characters',
+    'missing',
+    'padding',
+    'latency',
+    'latency-variance',
+    'fixtures',
+  ].forEach((key) => {
+    if (typeof args[key] !== 'undefined') {
+      server_args.push(`--${key}`, String(args[key]));
+    }
+  });
+
+  if (!['gaps', 'lowest'].includes(args['policy'])) {
+    throw `Unknown policy ${args['policy']}`;
+  }
+
+  return {
+    policy: args['policy'],
+    duration: Number(args['duration']) * 1000,
+    sample_every: Number(args['sample-every']),
+    base_url: args['base-url'],
+    server_args: server_args,
+  };
+}
+
+/**
+ * Forks the fixture server on an ephemeral port.
+ * @returns {Promise<{server: ChildProcess, base_url: string}>}
+ */
+function startFixtureServer(server_args) {
+  return new Promise((resolve, reject) => {
+    const server = fork(
+      path.join(__dirname, 'fixture_server.js'),
+      server_args.concat(['--port', '0']),
+      { stdio: ['ignore', 'ignore', 'inherit', 'ipc'] }
+    );
+    server.once('message', (msg) => {
+      resolve({ server: server, base_url: `http://127.0.0.1:${msg['port']}` });
+    });
+    server.once('error', reject);
+    server.once('exit', (code) => reject(`Fixture server exited: ${code}`));
+  });
+}
+
+/**
+ * Wraps fetch so every response body the crawler parses is counted.
+ */
+function countResponseBytes(counters) {
+  const original_fetch = globalThis.fetch;
+  globalThis.fetch = async (...args) => {
+    const response = await original_fetch(...args);
+    const text = await response.text();
+    counters['pages'] += 1;
+    counters['bytes'] += Buffer.byteLength(text);
+    return new Response(text, {
+      status: response.status,
+      headers: response.headers,
+    });
+  };
+}
+
+/**
+ * Counts the gaps of before that no gap of after overlaps, i.e. the gaps that
+ * were filled completely. Both are sorted by start as in GapScheduler.
+ * @param {Array<{start: number, end: number}>} before
+ * @param {Array<{start: number, end: number}>} after
+ * @returns {number}
+ */
+function countClosedGaps(before, after) {
+  let closed = 0;
+  let j = 0;
+  before.forEach((gap) => {
+    while (j < after.length && after[j]['end'] < gap['start']) {
+      ++j;
+    }
+    if (j === after.length || after[j]['start'] > gap['end']) {
+      ++closed;
+    }
+  });
+  return closed;
+}
+
+function sampleMemory(running_ids, start) {
+  if (typeof globalThis.gc === 'function') {
+    globalThis.gc();
+  }
+  return {
+    elapsed_ms: Math.round(performance.now() - start),
+    running_ids: running_ids.length,
+    heap_used: process.memoryUsage().heapUsed,
+  };
+}
+
+async function main() {
+  const opts = handleCLIArgs(process.argv.slice(2));
+  let server = null;
+  let base_url = opts['base_url'];
+  if (typeof base_url === 'undefined') {
+    ({ server, base_url } = await startFixtureServer(opts['server_args']));
+  }
+
+  const counters = { pages: 0, bytes: 0 };
+  countResponseBytes(counters);
+
+  const format_opts = { quote: '"', delimiter: '\t' };
+  const running_ids = [];
+  const scheduler = new GapScheduler();
+  // Only measures the gaps closed, whichever policy picks the IDs
+  const tracker = new GapScheduler();
+  const samples = [];
+  let iterations = 0;
+  let successful_crawls = 0;
+  let gaps_closed = 0;
+  let not_found = 0;
+  let dsv_bytes = 0;
+  // Microseconds spent measuring, which are not counted against the crawler
+  let tracker_cpu = 0;
+
+  const measureClosedGaps = () => {
+    const tracker_start = process.cpuUsage();
+    const before = tracker.gaps;
+    tracker.update(running_ids);
+    const usage = process.cpuUsage(tracker_start);
+    tracker_cpu += usage.user + usage.system;
+    return countClosedGaps(before, tracker.gaps);
+  };
+
+  // Deleted rolls are skipped so the crawl can move past them
+  const skipID = (target_id) => {
+    if (opts['policy'] === 'gaps') {
+      scheduler.recordNotFound(target_id);
+    } else {
+      running_ids.push(target_id);
+    }
+    tracker.recordNotFound(target_id);
+  };
+
+  const start = performance.now();
+  const start_cpu = process.cpuUsage();
+  samples.push(sampleMemory(running_ids, start));
+  measureClosedGaps();
+
+  try {
+    while (performance.now() - start < opts['duration']) {
+      let target_id;
+      if (opts['policy'] === 'gaps') {
+        scheduler.update(running_ids);
+        target_id = scheduler.next();
+      } else {
+        target_id = my_addon.missingID(toIDTypedArray(running_ids)).toString();
+      }
+      try {
+        const results = await crawl(
+          target_id,
+          format_opts,
+          running_ids,
+          base_url
+        );
+        dsv_bytes += Buffer.byteLength(results['dsv']);
+        ++successful_crawls;
+        // As in module.js, an ID missing from the character's rolls is skipped
+        // rather than queried forever
+        if (!running_ids.some((id) => Number(id) === Number(target_id))) {
+          skipID(target_id);
+        }
+      } catch (e) {
+        if (!(e instanceof RollNotFoundError)) {
+          throw e;
+        }
+        skipID(target_id);
+        ++not_found;
+      }
+      gaps_closed += measureClosedGaps();
+      if (++iterations % opts['sample_every'] === 0) {
+        samples.push(sampleMemory(running_ids, start));
+      }
+    }
+  } finally {
+    if (server !== null) {
+      server.removeAllListeners('exit');
+      server.kill();
+    }
+  }
+
+  const cpu = process.cpuUsage(start_cpu);
+  const elapsed = performance.now() - start;
+  const last = sampleMemory(running_ids, start);
+  samples.push(last);
+  const rolls_found = new Set(running_ids.map(Number)).size;
+
+  console.log(
+    JSON.stringify(
+      {
+        base_url: base_url,
+        policy: opts['policy'],
+        elapsed_ms: Math.round(elapsed),
+        iterations: iterations,
+        successful_crawls: successful_crawls,
+        not_found: not_found,
+        gaps_closed: gaps_closed,
+        gaps_closed_per_minute: (gaps_closed * 60000) / elapsed,
+        pages: counters['pages'],
+        rolls_found: rolls_found,
+        rolls_per_request: rolls_found / (counters['pages'] || 1),
+        bytes_parsed: counters['bytes'],
+        dsv_bytes: dsv_bytes,
+        cpu_us_per_page:
+          (cpu.user + cpu.system - tracker_cpu) / (counters['pages'] || 1),
+        running_ids: running_ids.length,
+        heap_growth: last['heap_used'] - samples[0]['heap_used'],
+        heap_bytes_per_id:
+          (last['heap_used'] - samples[0]['heap_used']) /
+          (running_ids.length || 1),
+        samples: samples,
+      },
+      null,
+      2
+    )
+  );
+}
+
+main();
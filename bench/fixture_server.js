@@ -0,0 +1,275 @@
+// Local stand-in for the perma-roller's idlook.php and dicelook.php so the
+// crawler can be exercised and benchmarked without touching cydel.net.
+//
+// Pages are either replayed from a fixtures directory (optionally recording
+// misses from an upstream server) or generated from a deterministic synthetic
+// archive laid out the same way as the real pages.
+const fs = require('fs');
+const http = require('http');
+const path = require('path');
+
+const id_query_path = 'idlook.php';
+const character_query_path = 'dicelook.php';
+
+const roll_headers = [
+  'ID',
+  'BD',
+  'CD',
+  'LD',
+  'MD',
+  'Character',
+  'URL',
+  'Purpose',
+  'Time',
+];
+
+/**
+ * Integer hash used to derive every synthetic attribute from a roll ID so the
+ * archive does not have to be stored.
+ * @param {number} x
+ * @returns {number} Unsigned 32-bit hash
+ */
+function mix(x) {
+  x = Math.imul(x ^ (x >>> 16), 0x7feb352d);
+  x = Math.imul(x ^ (x >>> 15), 0x846ca68b);
+  return (x ^ (x >>> 16)) >>> 0;
+}
+
+/**
+ * Builds the synthetic archive: which rolls exist and who owns them.
+ * @param {{rolls: number, characters: number, missing: number}} opts
+ * @returns {Object} Lookup tables for the synthetic archive
+ */
+function createSyntheticArchive(opts) {
+  const names = [];
+  for (let i = 0; i < opts['characters']; ++i) {
+    // A few names contain markup like the real "Pacman ghosts"
+    names.push(i % 97 === 3 ? `<b>Ghost</b> ${i}` : `Character ${i}`);
+  }
+
+  const owners = new Int32Array(opts['rolls'] + 1).fill(-1);
+  const rolls_by_character = names.map(() => []);
+  const missing_threshold = Math.floor(opts['missing'] * 0x100000000);
+  for (let id = 1; id <= opts['rolls']; ++id) {
+    if (mix(id ^ 0x5bd1e995) < missing_threshold) {
+      // Deleted roll: never returned by either endpoint
+      continue;
+    }
+    const owner = mix(id) % names.length;
+    owners[id] = owner;
+    rolls_by_character[owner].push(id);
+  }
+
+  return {
+    names: names,
+    owners: owners,
+    rolls_by_character: rolls_by_character,
+    character_index: new Map(names.map((name, idx) => [name, idx])),
+  };
+}
+
+function renderRoll(id, name, padding) {
+  const h = mix(id);
+  const time = new Date(Date.UTC(2014, 0, 1) + id * 60000)
+    .toISOString()
+    .replace('T', ' ')
+    .slice(0, 19);
+  const cells = [
+    id,
+    (h & 0xf) + 1,
+    ((h >>> 4) & 0xf) + 1,
+    ((h >>> 8) & 0xf) + 1,
+    ((h >>> 12) & 0xf) + 1,
+    name,
+    `<a href="http://example.com/thread/${h % 10000}">link</a>`,
+    'Rolling for "things"\t' + 'x'.repeat(padding),
+    time,
+  ];
+  return `<tr><td>${cells.join('</td><td>')}</td></tr>`;
+}
+
+// Mimics the real pages: the rolls are in the second table and the first row
+// of that table is the header. No tbody, which the parser has to fix up.
+function renderPage(rows) {
+  return (
+    '<html><head><title>Dice</title></head><body><center>' +
+    '<table><tr><td>Perma-roller</td></tr></table>' +
+    `<table border=1><tr><td>${roll_headers.join('</td><td>')}</td></tr>` +
+    rows.join('') +
+    '</table></center></body></html>'
+  );
+}
+
+function renderSynthetic(archive, type, key, opts) {
+  if (type === 'id') {
+    const id = Number.parseInt(key, 10);
+    if (!(id >= 1 && id < archive.owners.length) || archive.owners[id] < 0) {
+      return renderPage([]);
+    }
+    return renderPage([
+      renderRoll(id, archive.names[archive.owners[id]], opts['padding']),
+    ]);
+  }
+
+  const owner = archive.character_index.get(key);
+  if (typeof owner === 'undefined') {
+    return renderPage([]);
+  }
+  return renderPage(
+    archive.rolls_by_character[owner].map((id) =>
+      renderRoll(id, key, opts['padding'])
+    )
+  );
+}
+
+function fixturePath(fixtures, type, key) {
+  const dir = type === 'id' ? 'idlook' : 'dicelook';
+  return path.join(fixtures, dir, `${encodeURIComponent(key)}.html`);
+}
+
+/**
+ * Returns the page for the query from the fixtures, then the upstream server
+ * (recording it into the fixtures), then the synthetic archive.
+ */
+async function lookup(archive, type, key, form, opts) {
+  if (typeof opts['fixtures'] !== 'undefined') {
+    const file = fixturePath(opts['fixtures'], type, key);
+    try {
+      return await fs.promises.readFile(file, 'utf8');
+    } catch (e) {
+      if (typeof opts['record'] === 'undefined') {
+        throw e;
+      }
+    }
+
+    const page_path = type === 'id' ? id_query_path : character_query_path;
+    const upstream = new URL(opts['record']);
+    if (!upstream.pathname.endsWith('/')) {
+      upstream.pathname += '/';
+    }
+    const response = await fetch(new URL(page_path, upstream), {
+      method: 'POST',
+      headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
+      body: form,
+    });
+    if (!response.ok) {
+      // Error pages must not be replayed as if they were the real page
+      const error = new Error(`Upstream responded ${response.status}`);
+      error.status = 502;
+      throw error;
+    }
+    const page = await response.text();
+    await fs.promises.mkdir(path.dirname(file), { recursive: true });
+    await fs.promises.writeFile(file, page);
+    return page;
+  }
+  return renderSynthetic(archive, type, key, opts);
+}
+
+function delay(opts) {
+  const ms =
+    opts['latency'] + Math.random() * opts['latency_variance'] * 2 -
+    opts['latency_variance'];
+  return new Promise((resolve) => setTimeout(resolve, Math.max(0, ms)));
+}
+
+/**
+ * Creates (but does not start) the fixture server.
+ * @param {{rolls: number, characters: number, missing: number,
+ *     padding: number, latency: number, latency_variance: number,
+ *     fixtures: string, record: string}} opts Server options
+ * @returns {http.Server}
+ */
+function createFixtureServer(opts) {
+  const archive =
+    typeof opts['fixtures'] === 'undefined'
+      ? createSyntheticArchive(opts)
+      : null;
+
+  return http.createServer((req, res) => {
+    // Served under any path prefix, like the crawler's --base-url
+    const page_path = new URL(req.url, 'http://localhost').pathname
+      .split('/')
+      .pop();
+    let type;
+    if (page_path === id_query_path) {
+      type = 'id';
+    } else if (page_path === character_query_path) {
+      type = 'character';
+    } else {
+      res.writeHead(404).end();
+      return;
+    }
+
+    let body = '';
+    req.setEncoding('utf8');
+    req.on('data', (chunk) => (body += chunk));
+    req.on('end', async () => {
+      const form = new URLSearchParams(body);
+      const key = form.get('name') || '';
+      try {
+        const [page] = await Promise.all([
+          lookup(archive, type, key, body, opts),
+          delay(opts),
+        ]);
+        res.writeHead(200, { 'Content-Type': 'text/html' }).end(page);
+      } catch (e) {
+        res.writeHead(e.status || 404).end();
+      }
+    });
+  });
+}
+
+function handleCLIArgs(argv) {
+  const minimist = require('minimist');
+  const args = minimist(argv, {
+    string: ['fixtures', 'record'],
+    default: {
+      port: 8080,
+      rolls: 200000,
+      characters: 2000,
+      missing: 0.001,
+      padding: 0,
+      latency: 50,
+      'latency-variance': 0,
+    },
+  });
+
+  return {
+    port: Number(args['port']),
+    rolls: Number(args['rolls']),
+    characters: Number(args['characters']),
+    missing: Number(args['missing']),
+    padding: Number(args['padding']),
+    latency: Number(args['latency']),
+    latency_variance: Number(args['latency-variance']),
+    fixtures: args['fixtures'],
+    record: args['record'],
+  };
+}
+
+function main() {
+  const opts = handleCLIArgs(process.argv.slice(2));
+  const server = createFixtureServer(opts);
+  server.listen(opts['port'], '127.0.0.1', () => {
+    const port = server.address().port;
+    console.log(`Fixture server listening on http://127.0.0.1:${port}`);
+    // Lets a parent process (see crawl_bench.js) know where to connect
+    if (typeof process.send === 'function') {
+      process.send({ port: port });
+    }
+  });
+  // Do not outlive a parent that exited without killing the server
+  if (typeof process.send === 'function') {
+    process.once('disconnect', () => process.exit(0));
+  }
+}
+
+if (require.main === module) {
+  main();
+}
+
+module.exports = {
+  createFixtureServer: createFixtureServer,
+  createSyntheticArchive: createSyntheticArchive,
+};
@@ -0,0 +1,248 @@
+// Differential test of the ID parsers. Runs every build of main with the
+// two-stage parser (e.g. the SSE2, PCLMUL and scalar ones of make parser-diff)
+// and main built with -DMISSING_ID_LIBCSV on the same generated files and
+// reports any file where their output or exit status differ.
+//
+// Usage:
+//   node bench/parser_diff.js [main[,main...]] [main_libcsv] [cases] [seed]
+//
+// Every file holds the IDs 1..N with one removed, in the first and the last
+// column, so a record or field the parsers split differently shows up as a
+// different missing ID. The records are mixed with malformed quotes, CR/CRLF
+// line endings, NUL bytes and fields longer than a read buffer. Mismatching
+// files are kept in the printed directory.
+//
+// Only the quote and delimiter pairs below are covered since main takes them
+// as command line arguments, which cannot hold a NUL byte. NUL only shows up
+// within fields.
+const { spawnSync } = require('child_process');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+// Quote and delimiter pairs of the generated files
+const formats = [
+  { quote: '"', delimiter: '\t' },
+  { quote: '"', delimiter: ',' },
+  { quote: "'", delimiter: ' ' },
+  { quote: '"', delimiter: ';' },
+];
+
+const mutations = ['crlf', 'nul', 'long', 'malformed', 'soup'];
+
+const last_column = 4;
+
+/**
+ * Small seeded generator (mulberry32) so a failing seed can be replayed.
+ * @param {number} seed
+ * @returns {function(): number} Uniform numbers in [0, 1)
+ */
+function createRandom(seed) {
+  let state = seed >>> 0;
+  return () => {
+    state = (state + 0x6d2b79f5) >>> 0;
+    let x = state;
+    x = Math.imul(x ^ (x >>> 15), x | 1);
+    x ^= x + Math.imul(x ^ (x >>> 7), x | 61);
+    return ((x ^ (x >>> 14)) >>> 0) / 0x100000000;
+  };
+}
+
+/**
+ * Builds one filler field, quoted or not, with the mutation's special bytes.
+ * @param {function(): number} random
+ * @param {{quote: string, delimiter: string}} format
+ * @param {string} mutation One of mutations
+ * @returns {string}
+ */
+function createField(random, format, mutation) {
+  const { quote, delimiter } = format;
+  let alphabet = 'abc 123-+';
+  let length = Math.floor(random() * 12);
+
+  switch (mutation) {
+    case 'crlf':
+      alphabet += '\r\n';
+      break;
+    case 'nul':
+      alphabet += '\0\0';
+      break;
+    case 'long':
+      if (random() < 0.002) {
+        // Longer than the 64KiB read buffer
+        length = 65536 + Math.floor(random() * 70000);
+      }
+      break;
+  }
+
+  const pick = (chars) => chars[Math.floor(random() * chars.length)];
+  let body = '';
+  for (let i = 0; i < length; ++i) {
+    body += pick(alphabet);
+  }
+
+  if (random() < 0.5) {
+    // Quoted fields may hold anything, including doubled quotes
+    const inner = body + (random() < 0.3 ? quote + delimiter + '\n' : '');
+    const field = quote + inner.split(quote).join(quote + quote) + quote;
+    return ' '.repeat(Math.floor(random() * 2)) + field;
+  }
+
+  return body.replace(/[\r\n]/g, '');
+}
+
+/**
+ * Builds a field that is malformed or close to it. Only one is put in a file
+ * so that a parser missing one of the errors exits differently.
+ * @param {function(): number} random
+ * @param {{quote: string, delimiter: string}} format
+ * @returns {string}
+ */
+function createMalformedField(random, format) {
+  const { quote } = format;
+  const fields = [
+    // Quote within an unquoted field
+    `a${quote}b`,
+    `ab${quote}`,
+    // Text after the closing quote
+    `${quote}a${quote}b`,
+    `${quote}a${quote}${quote}`,
+    `${quote}a${quote} ${quote}`,
+    // Spaces around quotes are allowed
+    ` ${quote}a${quote} `,
+    `${quote}${quote}`,
+    `${quote}${quote}${quote}${quote}`,
+  ];
+  return fields[Math.floor(random() * fields.length)];
+}
+
+/**
+ * Generates an ID file for the format with one ID left out.
+ * @param {function(): number} random
+ * @param {{quote: string, delimiter: string}} format
+ * @param {string} mutation One of mutations
+ * @returns {Buffer}
+ */
+function createFile(random, format, mutation) {
+  const { quote, delimiter } = format;
+  const count = Math.floor(random() * 3000);
+  const missing = 1 + Math.floor(random() * (count + 1));
+  const terminators =
+    mutation === 'crlf' ? ['\n', '\r\n', '\r', '\n\n', '\r\n\r\n'] : ['\n'];
+
+  let text = '';
+  if (mutation === 'soup') {
+    // Weighted per file so that some files rarely or never hold a quote
+    const alphabet = [quote, delimiter, '\n', '\r', ' ', '1', '0', 'a', '\0'];
+    const weights = alphabet.map(() => random() ** 2);
+    const total = weights.reduce((sum, weight) => sum + weight, 0);
+    const length = Math.floor(random() * 4096);
+    for (let i = 0; i < length; ++i) {
+      let pick = random() * total;
+      let idx = 0;
+      while (idx < alphabet.length - 1 && pick >= weights[idx]) {
+        pick -= weights[idx++];
+      }
+      text += alphabet[idx];
+    }
+    return Buffer.from(text, 'latin1');
+  }
+
+  const malformed =
+    mutation === 'malformed' ? 1 + Math.floor(random() * (count + 1)) : -1;
+  const chunks = [];
+  for (let id = 1; id <= count + 1; ++id) {
+    if (id === missing) {
+      continue;
+    }
+    const fields = [String(id)];
+    for (let col = 1; col < last_column; ++col) {
+      fields.push(createField(random, format, mutation));
+    }
+    if (id === malformed) {
+      fields[1 + Math.floor(random() * (last_column - 1))] =
+        createMalformedField(random, format);
+    }
+    fields.push(String(id));
+    const terminator = terminators[Math.floor(random() * terminators.length)];
+    chunks.push(fields.join(delimiter) + terminator);
+  }
+  text = chunks.join('');
+
+  if (mutation === 'malformed' && random() < 0.2) {
+    // Not an error without CSV_STRICT_FINI
+    text += quote + 'unterminated' + delimiter;
+  }
+  return Buffer.from(text, 'latin1');
+}
+
+/**
+ * Runs main on the file and returns what is compared between the builds.
+ * Error messages are not compared since they come from different parsers.
+ * @param {string} main Path to the executable
+ * @param {Array<string>} args
+ * @returns {string}
+ */
+function runMain(main, args) {
+  const result = spawnSync(main, args, { encoding: 'latin1' });
+  if (result.error) {
+    throw result.error;
+  }
+  return `status ${result.status}: ${result.stdout.trim()}`;
+}
+
+function main(argv) {
+  const mains_dsv = (argv[0] || './main').split(',');
+  const main_libcsv = argv[1] || './main_libcsv';
+  const cases = Number.parseInt(argv[2] || '500', 10);
+  const seed = Number.parseInt(argv[3] || String(Date.now() % 100000), 10);
+
+  const random = createRandom(seed);
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'parser-diff-'));
+  let mismatches = 0;
+
+  for (let i = 0; i < cases; ++i) {
+    const format = formats[Math.floor(random() * formats.length)];
+    const mutation = mutations[i % mutations.length];
+    const file = path.join(dir, `case-${i}.dsv`);
+    fs.writeFileSync(file, createFile(random, format, mutation));
+
+    let matched = true;
+    [0, last_column].forEach((column) => {
+      [false, true].forEach((headers) => {
+        const args = ['-q', format.quote, '-d', format.delimiter];
+        args.push('-c', String(column), file);
+        if (headers) {
+          args.push('-h');
+        }
+        const expected = runMain(main_libcsv, args);
+        mains_dsv.forEach((main_dsv) => {
+          const actual = runMain(main_dsv, args);
+          if (actual !== expected) {
+            matched = false;
+            console.log(`Mismatch on ${file} (${mutation}) ${args.join(' ')}`);
+            console.log(`  libcsv:       ${expected}`);
+            console.log(`  ${main_dsv}: ${actual}`);
+          }
+        });
+      });
+    });
+
+    if (matched) {
+      fs.unlinkSync(file);
+    } else {
+      ++mismatches;
+    }
+  }
+
+  console.log(
+    `${cases} cases, ${mismatches} mismatches (seed ${seed})` +
+      (mismatches > 0 ? `, kept in ${dir}` : '')
+  );
+  if (mismatches === 0) {
+    fs.rmdirSync(dir);
+  }
+  return mismatches === 0 ? 0 : 1;
+}
+
+process.exitCode = main(process.argv.slice(2));
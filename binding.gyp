@@ -11,7 +11,10 @@
       "libraries": [
           "<(module_root_dir)/lib/missing_id.so",
           "<(module_root_dir)/lib/libcsv.so",
-          "<(module_root_dir)/lib/dynamic_long_array.so"
+          "<(module_root_dir)/lib/dynamic_array.so",
+          "<(module_root_dir)/lib/frozen_ids.so",
+          "<(module_root_dir)/lib/archive_stats.so",
+          "<(module_root_dir)/lib/dsv_index.so"
       ]
     }
   ]
@@ -0,0 +1,87 @@
+#ifndef ARCHIVE_STATS_H
+#define ARCHIVE_STATS_H
+
+#include "dynamic_array.h"
+
+/* Interned character name and the number of rolls attributed to it */
+struct character_count {
+  char *name;
+  size_t len;
+  unsigned long hash;
+  size_t count;
+};
+
+/* First occurrence of an ID, used to detect duplicates and conflicting rows */
+struct id_entry {
+  long id;
+  unsigned long row_hash;
+  size_t file_index;
+  size_t occurrences;
+  int conflicting;
+  int occupied;
+};
+
+/* Distinct IDs within the block of IDs [block * block_size, ...) */
+struct block_count {
+  long block;
+  size_t ids;
+  int occupied;
+};
+
+struct archive_stats_options {
+  long character_column;
+  long time_column;
+  long block_size;
+  unsigned char quote;
+  unsigned char token;
+  /* Whether malformed quotes are an error, as in compile_ids_from_files */
+  int strict;
+};
+
+struct archive_stats {
+  long block_size;
+
+  size_t files;
+  size_t rows;
+  size_t non_numeric_rows;
+  size_t distinct_ids;
+  size_t positive_ids;
+  size_t duplicate_ids;
+  size_t duplicate_rows;
+  long min_id;
+  long max_id;
+
+  /* Times are compared as strings, which holds for the crawler's format */
+  char *min_time;
+  char *max_time;
+
+  /* Open addressing tables with power of two capacities */
+  struct character_count *characters;
+  size_t character_len;
+  size_t character_capacity;
+
+  struct id_entry *ids;
+  size_t id_capacity;
+
+  /**
+   * Distinct IDs per block of block_size IDs, keyed by id / block_size. Only
+   * blocks with IDs are stored so outlying IDs do not blow up the histogram.
+   **/
+  struct block_count *blocks;
+  size_t block_len;
+  size_t block_capacity;
+
+  /* IDs whose rows differ between occurrences, in the order they were found */
+  struct dynamic_long_array conflicting_ids;
+};
+
+struct archive_stats compile_stats_from_files(const char* const* filenames,
+    const long *columns, size_t len, int ignore_headers,
+    const struct archive_stats_options *options, int *err_no);
+
+char *archive_stats_to_json(const struct archive_stats *stats,
+    const char* const* filenames, int *err_no);
+
+void free_archive_stats(struct archive_stats *stats);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef DSV_INDEX_H
+#define DSV_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Two-stage parser for quoted DSV files. Stage one (build_dsv_index) marks the
+ * delimiters and line terminators outside of quotes in 64-byte blocks, so
+ * quoted fields holding delimiters, line terminators or doubled quotes need
+ * no special casing. Stage two (dsv_parse_column) walks those marks to pull a
+ * single column out of every record.
+ *
+ * The records and fields match libcsv with CSV_STRICT, including where parsing
+ * stops on malformed quotes. Unlike libcsv, a field longer than
+ * DSV_MAX_FIELD_LEN bytes is an error, so a stray opening quote does not pull
+ * the rest of the file into memory. Build with -DMISSING_ID_LIBCSV to parse
+ * with libcsv instead, e.g. to compare the two.
+ **/
+
+#ifndef DSV_MAX_FIELD_LEN
+#define DSV_MAX_FIELD_LEN (16 * 1024 * 1024)
+#endif
+
+enum DsvErr {
+  kDsvOk,
+  kDsvParseError,
+  kDsvMemoryError,
+  kDsvReadError,
+  /* The field callback returned non-zero */
+  kDsvStopped,
+  /* A field is longer than DSV_MAX_FIELD_LEN */
+  kDsvFieldTooLong
+};
+
+/* Bit i of word i / 64 is set for byte i of the indexed buffer */
+struct dsv_index {
+  /* Delimiters and line terminators outside of quotes */
+  uint64_t *structurals;
+  /* Every quote character, used to validate and unescape quoted fields */
+  uint64_t *quotes;
+  size_t len;
+};
+
+int dsv_can_index(unsigned char quote, unsigned char token);
+
+void build_dsv_index(const unsigned char *buf, size_t len,
+                     unsigned char quote, unsigned char token,
+                     struct dsv_index *index);
+
+int dsv_parse_column(FILE *file, unsigned char quote, unsigned char token,
+    long column, int ignore_headers,
+    int (*field_callback)(void *, size_t, void *), void *data);
+
+const char *dsv_strerror(int error);
+
+#endif
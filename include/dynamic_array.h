@@ -0,0 +1,101 @@
+#ifndef DYNAMIC_ARRAY_H
+#define DYNAMIC_ARRAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Generates the declarations of struct dynamic_NAME_array, a growable array of
+ * TYPE, and its operations suffixed with _NAME. DEFINE_DYNAMIC_ARRAY generates
+ * the matching definitions and should only be used once per NAME (see
+ * dynamic_array.c).
+ **/
+#define DECLARE_DYNAMIC_ARRAY(NAME, TYPE)                                      \
+  struct dynamic_##NAME##_array {                                             \
+    TYPE *array;                                                              \
+    size_t len;                                                               \
+    size_t capacity;                                                          \
+  };                                                                          \
+                                                                              \
+  int append_##NAME(TYPE element,                                             \
+                    struct dynamic_##NAME##_array *dynamic_array);            \
+                                                                              \
+  int at_capacity_##NAME(struct dynamic_##NAME##_array *dynamic_array);       \
+                                                                              \
+  int extend_array_##NAME(struct dynamic_##NAME##_array *dynamic_array);      \
+                                                                              \
+  void free_dynamic_##NAME##_array(                                           \
+      struct dynamic_##NAME##_array *dynamic_array);                          \
+                                                                              \
+  struct dynamic_##NAME##_array create_dynamic_##NAME##_array(                \
+      size_t initial_capacity, int *err_no);
+
+#define DEFINE_DYNAMIC_ARRAY(NAME, TYPE)                                       \
+  int append_##NAME(TYPE element,                                             \
+                    struct dynamic_##NAME##_array *dynamic_array) {           \
+    if (at_capacity_##NAME(dynamic_array)) {                                  \
+      int result = extend_array_##NAME(dynamic_array);                        \
+      if (result != 0) {                                                      \
+        return result;                                                        \
+      }                                                                       \
+    }                                                                         \
+                                                                              \
+    dynamic_array->array[dynamic_array->len++] = element;                     \
+    return 0;                                                                 \
+  }                                                                           \
+                                                                              \
+  int at_capacity_##NAME(struct dynamic_##NAME##_array *dynamic_array) {      \
+    return dynamic_array->len == dynamic_array->capacity;                     \
+  }                                                                           \
+                                                                              \
+  int extend_array_##NAME(struct dynamic_##NAME##_array *dynamic_array) {     \
+    TYPE *new_ptr;                                                            \
+    if (at_capacity_##NAME(dynamic_array) &&                                  \
+        dynamic_array->capacity * 2 < dynamic_array->capacity) {              \
+      fprintf(stderr, "Increasing capacity past %lu will exceed system's"     \
+                      "implementation of size_t causing an overflow\n",       \
+                      (unsigned long)dynamic_array->capacity);                \
+      return -1;                                                              \
+    } else if (dynamic_array->capacity == 0) {                                \
+      dynamic_array->capacity = 1;                                            \
+    }                                                                         \
+                                                                              \
+    dynamic_array->capacity *= 2;                                             \
+    new_ptr = realloc(dynamic_array->array,                                   \
+        sizeof(TYPE) * dynamic_array->capacity);                              \
+    if (new_ptr == NULL) {                                                    \
+      fprintf(stderr, "Error reallocating dynamic " #NAME " array with new"   \
+                      " capacity %lu\n",                                      \
+                      (unsigned long)dynamic_array->capacity);                \
+      return 1;                                                               \
+    }                                                                         \
+    dynamic_array->array = new_ptr;                                           \
+    return 0;                                                                 \
+  }                                                                           \
+                                                                              \
+  void free_dynamic_##NAME##_array(                                           \
+      struct dynamic_##NAME##_array *dynamic_array) {                         \
+    free(dynamic_array->array);                                               \
+  }                                                                           \
+                                                                              \
+  struct dynamic_##NAME##_array create_dynamic_##NAME##_array(                \
+      size_t initial_capacity, int *err_no) {                                 \
+    struct dynamic_##NAME##_array dynamic_array;                              \
+    dynamic_array.array = calloc(initial_capacity, sizeof(TYPE));             \
+    if (dynamic_array.array == NULL && initial_capacity != 0) {               \
+      fprintf(stderr, "Failed creating dynamic " #NAME " array with initial"  \
+                      " capacity of %lu\n", (unsigned long)initial_capacity); \
+      *err_no = 1;                                                            \
+    } else {                                                                  \
+      *err_no = 0;                                                            \
+    }                                                                         \
+    dynamic_array.len = 0;                                                    \
+    dynamic_array.capacity = initial_capacity;                                \
+    return dynamic_array;                                                     \
+  }
+
+DECLARE_DYNAMIC_ARRAY(long, long)
+DECLARE_DYNAMIC_ARRAY(int32, int32_t)
+DECLARE_DYNAMIC_ARRAY(int64, int64_t)
+
+#endif
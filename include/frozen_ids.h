@@ -0,0 +1,33 @@
+#ifndef FROZEN_IDS_H
+#define FROZEN_IDS_H
+
+#include "missing_id.h"
+
+/**
+ * Read-only, sorted and deduplicated set of IDs encoded as varints after a
+ * header of "MID" and the format version:
+ *   count, zigzag(first ID), (ID[i] - ID[i-1] - 1) for every following ID
+ * Runs of consecutive IDs take one byte each, which makes it suited to the
+ * long-lived sets of found IDs that are mostly gap free. The header lets any
+ * other byte array be rejected instead of being decoded as IDs.
+ **/
+#define FROZEN_IDS_VERSION 1
+#define FROZEN_IDS_HEADER_LEN 4
+
+enum FrozenErr {
+  kFrozenOk,
+  kFrozenCorrupted,
+  kFrozenNotFrozen
+};
+
+struct frozen_ids {
+  unsigned char *bytes;
+  size_t len;
+};
+
+struct frozen_ids freeze_ids(const struct id_array *ids, int *err_no);
+
+long frozen_missing_number(const unsigned char *bytes, size_t len,
+                           int *err_no);
+
+#endif
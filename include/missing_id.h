@@ -1,15 +1,43 @@
 #ifndef MISSING_ID_H
 #define MISSING_ID_H
 
-#include "dynamic_long_array.h"
+#include "dynamic_array.h"
+
+/**
+ * Width of the IDs in a struct id_array. kWidthAuto starts with 32-bit IDs
+ * and widens to 64-bit the first time a parsed ID does not fit. Build with
+ * -DMISSING_ID_WIDTH=32 or 64 to change the default of main and the addon.
+ **/
+enum IdWidth {
+  kWidthAuto = 0,
+  kWidth32 = 32,
+  kWidth64 = 64
+};
+
+#ifndef MISSING_ID_WIDTH
+#define MISSING_ID_WIDTH kWidthAuto
+#endif
+
+struct id_array {
+  /* Either kWidth32 (narrow is used) or kWidth64 (wide is used) */
+  int width;
+  /* Whether the width was requested and may not be widened */
+  int fixed;
+  struct dynamic_int32_array narrow;
+  struct dynamic_int64_array wide;
+};
 
 struct parser_info {
   struct dynamic_long_array *array;
+  /* Used instead of array when compiling into an id_array */
+  struct id_array *ids;
   int ignore_headers;
   long id_column;
 
   int past_header;
   long current_column;
+  /* Non-zero once an ID could not be stored, which stops the parsing */
+  int error;
 };
 
 enum Err {
@@ -21,12 +49,31 @@ enum Err {
 
 long missing_number(long *array, size_t len);
 
+long missing_number_int32(int32_t *array, size_t len);
+
+long missing_number_int64(int64_t *array, size_t len);
+
+struct id_array create_id_array(int width, size_t initial_capacity,
+                                int *err_no);
+
+int append_id(long element, struct id_array *ids);
+
+size_t id_array_len(const struct id_array *ids);
+
+long id_array_missing_number(struct id_array *ids);
+
+void free_id_array(struct id_array *ids);
+
 void field_callback(void *s, size_t len, void *data);
 
 void record_callback(int c, void *data);
 
 struct dynamic_long_array compile_ids_from_files(const char* const* filenames,
     const long *columns, size_t len, int ignore_headers, unsigned char quote,
-    unsigned char token, size_t starting_capacity, int *err_no);
+    unsigned char token, int strict, size_t starting_capacity, int *err_no);
+
+struct id_array compile_compact_ids_from_files(const char* const* filenames,
+    const long *columns, size_t len, int ignore_headers, unsigned char quote,
+    unsigned char token, int strict, int width, int *err_no);
 
 #endif
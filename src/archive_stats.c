@@ -0,0 +1,695 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "archive_stats.h"
+#include "dynamic_array.h"
+#include "csv.h"
+
+/**
+ * Statistics over a set of DSV archives computed in a single pass of libcsv.
+ * Every field is seen exactly once: the ID, character and time columns are
+ * remembered until the end of the record while every field is folded into a
+ * hash of the row so that rows sharing an ID can be compared without keeping
+ * the rows themselves in memory.
+ **/
+
+struct stats_parser_info {
+  struct archive_stats *stats;
+  const struct archive_stats_options *options;
+  int ignore_headers;
+  long id_column;
+  size_t file_index;
+
+  int past_header;
+  long current_column;
+
+  /* State of the current record */
+  unsigned long row_hash;
+  long id;
+  int has_id;
+  int has_fields;
+  char *character;
+  size_t character_len;
+  size_t character_capacity;
+  char *time;
+  size_t time_len;
+  size_t time_capacity;
+
+  int error;
+};
+
+/* 32-bit FNV-1a, masked so results match regardless of sizeof(long) */
+static unsigned long hash_bytes(unsigned long hash, const char *s, size_t len) {
+  size_t i;
+  for (i = 0; i < len; ++i) {
+    hash ^= (unsigned char)s[i];
+    hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+  }
+  return hash;
+}
+
+static unsigned long hash_id(long id) {
+  unsigned long hash = ((unsigned long)id * 2654435769UL) & 0xFFFFFFFFUL;
+  return hash ^ (hash >> 16);
+}
+
+/* Copies a field into a reusable buffer since libcsv reuses its own */
+static int copy_field(char **buf, size_t *len, size_t *capacity,
+                      const char *s, size_t field_len) {
+  if (field_len + 1 > *capacity) {
+    size_t new_capacity = (*capacity == 0) ? 32 : *capacity;
+    char *new_buf;
+    while (new_capacity < field_len + 1) {
+      new_capacity *= 2;
+    }
+    new_buf = realloc(*buf, new_capacity);
+    if (new_buf == NULL) {
+      return 1;
+    }
+    *buf = new_buf;
+    *capacity = new_capacity;
+  }
+  memcpy(*buf, s, field_len);
+  (*buf)[field_len] = '\0';
+  *len = field_len;
+  return 0;
+}
+
+static int grow_characters(struct archive_stats *stats) {
+  size_t new_capacity = stats->character_capacity * 2;
+  struct character_count *new_table;
+  size_t i;
+
+  new_table = calloc(new_capacity, sizeof(struct character_count));
+  if (new_table == NULL) {
+    return 1;
+  }
+  for (i = 0; i < stats->character_capacity; ++i) {
+    size_t j;
+    if (stats->characters[i].name == NULL) {
+      continue;
+    }
+    j = stats->characters[i].hash & (new_capacity - 1);
+    while (new_table[j].name != NULL) {
+      j = (j + 1) & (new_capacity - 1);
+    }
+    new_table[j] = stats->characters[i];
+  }
+  free(stats->characters);
+  stats->characters = new_table;
+  stats->character_capacity = new_capacity;
+  return 0;
+}
+
+static int count_character(struct archive_stats *stats, const char *name,
+                           size_t len) {
+  unsigned long hash = hash_bytes(2166136261UL, name, len);
+  size_t i;
+
+  if ((stats->character_len + 1) * 2 > stats->character_capacity &&
+      grow_characters(stats) != 0) {
+    return 1;
+  }
+
+  i = hash & (stats->character_capacity - 1);
+  while (stats->characters[i].name != NULL) {
+    struct character_count *entry = &stats->characters[i];
+    if (entry->hash == hash && entry->len == len &&
+        memcmp(entry->name, name, len) == 0) {
+      ++entry->count;
+      return 0;
+    }
+    i = (i + 1) & (stats->character_capacity - 1);
+  }
+
+  if ((stats->characters[i].name = malloc(len + 1)) == NULL) {
+    return 1;
+  }
+  memcpy(stats->characters[i].name, name, len);
+  stats->characters[i].name[len] = '\0';
+  stats->characters[i].len = len;
+  stats->characters[i].hash = hash;
+  stats->characters[i].count = 1;
+  ++stats->character_len;
+  return 0;
+}
+
+static int grow_ids(struct archive_stats *stats) {
+  size_t new_capacity = stats->id_capacity * 2;
+  struct id_entry *new_table;
+  size_t i;
+
+  new_table = calloc(new_capacity, sizeof(struct id_entry));
+  if (new_table == NULL) {
+    return 1;
+  }
+  for (i = 0; i < stats->id_capacity; ++i) {
+    size_t j;
+    if (!stats->ids[i].occupied) {
+      continue;
+    }
+    j = hash_id(stats->ids[i].id) & (new_capacity - 1);
+    while (new_table[j].occupied) {
+      j = (j + 1) & (new_capacity - 1);
+    }
+    new_table[j] = stats->ids[i];
+  }
+  free(stats->ids);
+  stats->ids = new_table;
+  stats->id_capacity = new_capacity;
+  return 0;
+}
+
+static struct id_entry *find_id(const struct archive_stats *stats, long id) {
+  size_t i = hash_id(id) & (stats->id_capacity - 1);
+  while (stats->ids[i].occupied) {
+    if (stats->ids[i].id == id) {
+      return &stats->ids[i];
+    }
+    i = (i + 1) & (stats->id_capacity - 1);
+  }
+  return &stats->ids[i];
+}
+
+static int grow_blocks(struct archive_stats *stats) {
+  size_t new_capacity = stats->block_capacity * 2;
+  struct block_count *new_table;
+  size_t i;
+
+  new_table = calloc(new_capacity, sizeof(struct block_count));
+  if (new_table == NULL) {
+    return 1;
+  }
+  for (i = 0; i < stats->block_capacity; ++i) {
+    size_t j;
+    if (!stats->blocks[i].occupied) {
+      continue;
+    }
+    j = hash_id(stats->blocks[i].block) & (new_capacity - 1);
+    while (new_table[j].occupied) {
+      j = (j + 1) & (new_capacity - 1);
+    }
+    new_table[j] = stats->blocks[i];
+  }
+  free(stats->blocks);
+  stats->blocks = new_table;
+  stats->block_capacity = new_capacity;
+  return 0;
+}
+
+static int count_block(struct archive_stats *stats, long id) {
+  long block;
+  size_t i;
+  if (id < 0) {
+    /* Negative IDs are treated as erroneous input, as in missing_number */
+    return 0;
+  }
+  if ((stats->block_len + 1) * 2 > stats->block_capacity &&
+      grow_blocks(stats) != 0) {
+    fprintf(stderr, "Failed to extend histogram to %lu blocks\n",
+            (unsigned long)stats->block_capacity * 2);
+    return 1;
+  }
+
+  block = id / stats->block_size;
+  i = hash_id(block) & (stats->block_capacity - 1);
+  while (stats->blocks[i].occupied && stats->blocks[i].block != block) {
+    i = (i + 1) & (stats->block_capacity - 1);
+  }
+  if (!stats->blocks[i].occupied) {
+    stats->blocks[i].occupied = 1;
+    stats->blocks[i].block = block;
+    stats->blocks[i].ids = 0;
+    ++stats->block_len;
+  }
+  ++stats->blocks[i].ids;
+  return 0;
+}
+
+static int count_id(struct archive_stats *stats, long id,
+                    unsigned long row_hash, size_t file_index, int *is_new) {
+  struct id_entry *entry;
+
+  *is_new = 0;
+  if ((stats->distinct_ids + 1) * 2 > stats->id_capacity &&
+      grow_ids(stats) != 0) {
+    return 1;
+  }
+
+  entry = find_id(stats, id);
+  if (entry->occupied) {
+    ++entry->occurrences;
+    ++stats->duplicate_rows;
+    if (entry->occurrences == 2) {
+      ++stats->duplicate_ids;
+    }
+    if (entry->row_hash != row_hash && !entry->conflicting) {
+      entry->conflicting = 1;
+      return append_long(id, &stats->conflicting_ids);
+    }
+    return 0;
+  }
+
+  *is_new = 1;
+  entry->occupied = 1;
+  entry->id = id;
+  entry->row_hash = row_hash;
+  entry->file_index = file_index;
+  entry->occurrences = 1;
+  entry->conflicting = 0;
+
+  if (stats->distinct_ids == 0 || id < stats->min_id) {
+    stats->min_id = id;
+  }
+  if (stats->distinct_ids == 0 || id > stats->max_id) {
+    stats->max_id = id;
+  }
+  ++stats->distinct_ids;
+  if (id > 0) {
+    ++stats->positive_ids;
+  }
+  return count_block(stats, id);
+}
+
+static int update_time(char **bound, const char *time, size_t len,
+                       int want_less) {
+  char *copy;
+  if (*bound != NULL) {
+    int cmp = strcmp(time, *bound);
+    if ((want_less && cmp >= 0) || (!want_less && cmp <= 0)) {
+      return 0;
+    }
+  }
+  if ((copy = malloc(len + 1)) == NULL) {
+    return 1;
+  }
+  memcpy(copy, time, len + 1);
+  free(*bound);
+  *bound = copy;
+  return 0;
+}
+
+/**
+ * Relies on CSV_APPEND_NULL so the ID field can be handed to strtol directly.
+ **/
+static void stats_field_callback(void *s, size_t len, void *data) {
+  struct stats_parser_info *info = (struct stats_parser_info *)data;
+  long column = info->current_column++;
+
+  if ((info->ignore_headers && !info->past_header) || info->error) {
+    return;
+  }
+
+  info->has_fields = 1;
+  info->row_hash = hash_bytes(info->row_hash, (const char *)s, len);
+  /* Separates fields so that "ab","c" and "a","bc" hash differently */
+  info->row_hash = hash_bytes(info->row_hash, "\x1f", 1);
+
+  if (column == info->id_column) {
+    char *end;
+    info->id = strtol((const char *)s, &end, 10);
+    info->has_id = (end != (char *)s && *end == '\0');
+  }
+  if (column == info->options->character_column &&
+      copy_field(&info->character, &info->character_len,
+                 &info->character_capacity, (const char *)s, len) != 0) {
+    info->error = 1;
+  }
+  if (column == info->options->time_column &&
+      copy_field(&info->time, &info->time_len, &info->time_capacity,
+                 (const char *)s, len) != 0) {
+    info->error = 1;
+  }
+}
+
+static void stats_record_callback(int c, void *data) {
+  struct stats_parser_info *info = (struct stats_parser_info *)data;
+  struct archive_stats *stats = info->stats;
+  int skip = (info->ignore_headers && !info->past_header) || info->error ||
+             !info->has_fields;
+  int is_new;
+
+  /* The line terminator (or -1 for an unterminated record) is not needed */
+  (void)c;
+
+  info->past_header = 1;
+  info->current_column = 0;
+
+  if (!skip) {
+    ++stats->rows;
+    if (!info->has_id) {
+      ++stats->non_numeric_rows;
+    } else if (count_id(stats, info->id, info->row_hash,
+                        info->file_index, &is_new) != 0) {
+      info->error = 1;
+    } else {
+      /* Rolls are only attributed once no matter how many files repeat them */
+      if (is_new && info->character_len > 0 &&
+          count_character(stats, info->character, info->character_len) != 0) {
+        info->error = 1;
+      }
+      if (info->time_len > 0 &&
+          (update_time(&stats->min_time, info->time, info->time_len, 1) != 0 ||
+           update_time(&stats->max_time, info->time, info->time_len, 0) != 0)) {
+        info->error = 1;
+      }
+    }
+  }
+
+  info->row_hash = 2166136261UL;
+  info->has_id = 0;
+  info->has_fields = 0;
+  info->character_len = 0;
+  info->time_len = 0;
+}
+
+struct archive_stats compile_stats_from_files(const char* const* filenames,
+    const long *columns, size_t len, int ignore_headers,
+    const struct archive_stats_options *options, int *err_no) {
+  struct archive_stats stats;
+  struct stats_parser_info info;
+  struct csv_parser p;
+  char buf[1024];
+  size_t bytes_read, i;
+
+  memset(&stats, 0, sizeof(stats));
+  memset(&info, 0, sizeof(info));
+  stats.block_size = (options->block_size > 0) ? options->block_size : 10000;
+  stats.character_capacity = 64;
+  stats.id_capacity = 1024;
+  stats.block_capacity = 64;
+  stats.characters = calloc(stats.character_capacity,
+                            sizeof(struct character_count));
+  stats.ids = calloc(stats.id_capacity, sizeof(struct id_entry));
+  stats.blocks = calloc(stats.block_capacity, sizeof(struct block_count));
+  stats.conflicting_ids = create_dynamic_long_array(16, err_no);
+  if (*err_no != 0 || stats.characters == NULL || stats.ids == NULL ||
+      stats.blocks == NULL) {
+    fprintf(stderr, "Failed allocating tables for archive statistics\n");
+    *err_no = 1;
+    return stats;
+  }
+
+  /**
+   * Strict like compile_ids_from_files so that both reject the same files, but
+   * empty fields stay non-NULL for the strtol and hashing below
+   **/
+  if (csv_init(&p, (options->strict ? CSV_STRICT : 0) | CSV_APPEND_NULL) !=
+      0) {
+    fprintf(stderr, "Error creating csv parser\n");
+    *err_no = 1;
+    return stats;
+  }
+  csv_set_delim(&p, options->token);
+  csv_set_quote(&p, options->quote);
+
+  info.stats = &stats;
+  info.options = options;
+  info.ignore_headers = ignore_headers;
+  info.row_hash = 2166136261UL;
+
+  for (i = 0; i < len; ++i) {
+    FILE *file;
+
+    info.id_column = columns[i];
+    info.file_index = i;
+    info.past_header = 0;
+    info.current_column = 0;
+
+    file = fopen(filenames[i], "r");
+    if (file == NULL) {
+      fprintf(stderr, "Error opening file: %s\n", filenames[i]);
+      *err_no = 2;
+      break;
+    }
+    while ((bytes_read = fread(buf, 1, 1024, file)) > 0) {
+      if (csv_parse(&p, buf, bytes_read, stats_field_callback,
+                    stats_record_callback, &info) != bytes_read) {
+        fprintf(stderr, "Error while parsing file: %s\n",
+                csv_strerror(csv_error(&p)));
+        *err_no = 3;
+        break;
+      }
+      if (info.error) {
+        fprintf(stderr, "Error allocating memory while reading: %s\n",
+                filenames[i]);
+        *err_no = 1;
+        break;
+      }
+    }
+    fclose(file);
+    if (*err_no != 0) {
+      break;
+    }
+    csv_fini(&p, stats_field_callback, stats_record_callback, &info);
+    if (info.error) {
+      *err_no = 1;
+      break;
+    }
+    ++stats.files;
+  }
+
+  free(info.character);
+  free(info.time);
+  csv_free(&p);
+  return stats;
+}
+
+void free_archive_stats(struct archive_stats *stats) {
+  size_t i;
+  if (stats->characters != NULL) {
+    for (i = 0; i < stats->character_capacity; ++i) {
+      free(stats->characters[i].name);
+    }
+  }
+  free(stats->characters);
+  free(stats->ids);
+  free(stats->blocks);
+  free(stats->min_time);
+  free(stats->max_time);
+  free_dynamic_long_array(&stats->conflicting_ids);
+}
+
+/* Growable string used to build the JSON output. Errors are sticky. */
+struct json_buffer {
+  char *buf;
+  size_t len;
+  size_t capacity;
+  int failed;
+};
+
+static void json_append(struct json_buffer *json, const char *s, size_t len) {
+  if (json->failed) {
+    return;
+  }
+  if (json->len + len + 1 > json->capacity) {
+    size_t new_capacity = (json->capacity == 0) ? 256 : json->capacity;
+    char *new_buf;
+    while (new_capacity < json->len + len + 1) {
+      new_capacity *= 2;
+    }
+    if ((new_buf = realloc(json->buf, new_capacity)) == NULL) {
+      json->failed = 1;
+      return;
+    }
+    json->buf = new_buf;
+    json->capacity = new_capacity;
+  }
+  memcpy(json->buf + json->len, s, len);
+  json->len += len;
+  json->buf[json->len] = '\0';
+}
+
+static void json_literal(struct json_buffer *json, const char *s) {
+  json_append(json, s, strlen(s));
+}
+
+static void json_ulong(struct json_buffer *json, unsigned long value) {
+  char num[32];
+  sprintf(num, "%lu", value);
+  json_literal(json, num);
+}
+
+static void json_long(struct json_buffer *json, long value) {
+  char num[32];
+  sprintf(num, "%ld", value);
+  json_literal(json, num);
+}
+
+/* Character names may contain HTML, so quotes and control bytes are escaped */
+static void json_string(struct json_buffer *json, const char *s) {
+  static const char hex[] = "0123456789abcdef";
+  json_append(json, "\"", 1);
+  for (; *s != '\0'; ++s) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\') {
+      char escaped[2];
+      escaped[0] = '\\';
+      escaped[1] = (char)c;
+      json_append(json, escaped, 2);
+    } else if (c < 0x20) {
+      char escaped[6] = { '\\', 'u', '0', '0', 0, 0 };
+      escaped[4] = hex[c >> 4];
+      escaped[5] = hex[c & 0xF];
+      json_append(json, escaped, 6);
+    } else {
+      json_append(json, s, 1);
+    }
+  }
+  json_append(json, "\"", 1);
+}
+
+static int compare_block_counts(const void *a, const void *b) {
+  const struct block_count *lhs = *(const struct block_count **)a;
+  const struct block_count *rhs = *(const struct block_count **)b;
+  return (lhs->block > rhs->block) - (lhs->block < rhs->block);
+}
+
+static int compare_character_counts(const void *a, const void *b) {
+  const struct character_count *lhs = *(const struct character_count **)a;
+  const struct character_count *rhs = *(const struct character_count **)b;
+  if (lhs->count != rhs->count) {
+    return (lhs->count < rhs->count) ? 1 : -1;
+  }
+  return strcmp(lhs->name, rhs->name);
+}
+
+char *archive_stats_to_json(const struct archive_stats *stats,
+    const char* const* filenames, int *err_no) {
+  struct json_buffer json;
+  const struct character_count **sorted;
+  const struct block_count **blocks;
+  size_t i, j;
+
+  memset(&json, 0, sizeof(json));
+  *err_no = 0;
+
+  json_literal(&json, "{\"files\":[");
+  for (i = 0; i < stats->files; ++i) {
+    if (i > 0) {
+      json_literal(&json, ",");
+    }
+    json_string(&json, filenames[i]);
+  }
+
+  json_literal(&json, "],\"rows\":");
+  json_ulong(&json, (unsigned long)stats->rows);
+  json_literal(&json, ",\"non_numeric_rows\":");
+  json_ulong(&json, (unsigned long)stats->non_numeric_rows);
+
+  json_literal(&json, ",\"ids\":{\"distinct\":");
+  json_ulong(&json, (unsigned long)stats->distinct_ids);
+  if (stats->distinct_ids > 0) {
+    json_literal(&json, ",\"min\":");
+    json_long(&json, stats->min_id);
+    json_literal(&json, ",\"max\":");
+    json_long(&json, stats->max_id);
+    json_literal(&json, ",\"missing\":");
+    json_ulong(&json, (stats->max_id > 0)
+        ? (unsigned long)stats->max_id - (unsigned long)stats->positive_ids
+        : 0UL);
+  } else {
+    json_literal(&json, ",\"min\":null,\"max\":null,\"missing\":0");
+  }
+
+  json_literal(&json, "},\"time\":{\"min\":");
+  if (stats->min_time != NULL) {
+    json_string(&json, stats->min_time);
+    json_literal(&json, ",\"max\":");
+    json_string(&json, stats->max_time);
+  } else {
+    json_literal(&json, "null,\"max\":null");
+  }
+
+  json_literal(&json, "},\"duplicates\":{\"ids\":");
+  json_ulong(&json, (unsigned long)stats->duplicate_ids);
+  json_literal(&json, ",\"rows\":");
+  json_ulong(&json, (unsigned long)stats->duplicate_rows);
+  json_literal(&json, ",\"conflicting\":[");
+  for (i = 0; i < stats->conflicting_ids.len; ++i) {
+    const struct id_entry *entry =
+        find_id(stats, stats->conflicting_ids.array[i]);
+    if (i > 0) {
+      json_literal(&json, ",");
+    }
+    json_literal(&json, "{\"id\":");
+    json_long(&json, entry->id);
+    json_literal(&json, ",\"occurrences\":");
+    json_ulong(&json, (unsigned long)entry->occurrences);
+    json_literal(&json, ",\"first_file\":");
+    json_string(&json, filenames[entry->file_index]);
+    json_literal(&json, "}");
+  }
+
+  json_literal(&json, "]},\"blocks\":{\"size\":");
+  json_long(&json, stats->block_size);
+  json_literal(&json, ",\"histogram\":[");
+  /* Only the blocks with IDs, in order */
+  blocks = malloc((stats->block_len + 1) * sizeof(const struct block_count *));
+  if (blocks == NULL) {
+    json.failed = 1;
+  } else {
+    for (i = 0, j = 0; i < stats->block_capacity; ++i) {
+      if (stats->blocks[i].occupied) {
+        blocks[j++] = &stats->blocks[i];
+      }
+    }
+    qsort((void *)blocks, j, sizeof(const struct block_count *),
+          compare_block_counts);
+    for (i = 0; i < j; ++i) {
+      char density[32];
+      unsigned long start =
+          (unsigned long)blocks[i]->block * (unsigned long)stats->block_size;
+      if (i > 0) {
+        json_literal(&json, ",");
+      }
+      json_literal(&json, "{\"start\":");
+      json_ulong(&json, start);
+      json_literal(&json, ",\"end\":");
+      json_ulong(&json, start + (unsigned long)(stats->block_size - 1));
+      json_literal(&json, ",\"ids\":");
+      json_ulong(&json, (unsigned long)blocks[i]->ids);
+      sprintf(density, ",\"density\":%.4f",
+              (double)blocks[i]->ids / (double)stats->block_size);
+      json_literal(&json, density);
+      json_literal(&json, "}");
+    }
+    free((void *)blocks);
+  }
+
+  json_literal(&json, "]},\"characters\":[");
+  sorted = malloc((stats->character_len + 1) *
+                  sizeof(const struct character_count *));
+  if (sorted == NULL) {
+    json.failed = 1;
+  } else {
+    for (i = 0, j = 0; i < stats->character_capacity; ++i) {
+      if (stats->characters[i].name != NULL) {
+        sorted[j++] = &stats->characters[i];
+      }
+    }
+    qsort((void *)sorted, j, sizeof(const struct character_count *),
+          compare_character_counts);
+    for (i = 0; i < j; ++i) {
+      if (i > 0) {
+        json_literal(&json, ",");
+      }
+      json_literal(&json, "{\"name\":");
+      json_string(&json, sorted[i]->name);
+      json_literal(&json, ",\"rolls\":");
+      json_ulong(&json, (unsigned long)sorted[i]->count);
+      json_literal(&json, "}");
+    }
+    free((void *)sorted);
+  }
+  json_literal(&json, "]}");
+
+  if (json.failed) {
+    fprintf(stderr, "Failed allocating JSON output for archive statistics\n");
+    free(json.buf);
+    *err_no = 1;
+    return NULL;
+  }
+  return json.buf;
+}
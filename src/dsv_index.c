@@ -0,0 +1,427 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __PCLMUL__
+#include <wmmintrin.h>
+#endif
+
+#include "dsv_index.h"
+
+#define BLOCK_SIZE 64
+/* Multiple of BLOCK_SIZE so only the last block of a file is partial */
+#define READ_SIZE (64 * 1024)
+
+/**
+ * Stage one follows the simdjson approach: compare each 64-byte block against
+ * the quote, delimiter and line terminators to get one bit per byte, then
+ * take the prefix XOR of the quote bits so that every byte between an opening
+ * and closing quote is masked out. A doubled quote flips the mask twice and
+ * leaves it unchanged, so escaped quotes need no special casing. Whether the
+ * previous block ended inside quotes is carried over to the next one.
+ *
+ * With CSV_STRICT, libcsv only accepts a quote at the start of a field, as the
+ * closing quote or doubled within a quoted field, where the quote parity and
+ * libcsv agree on every field. Stage two validates that each field is one of
+ * those before passing it on, so the fields agree up to the first one libcsv
+ * rejects, which is also where parsing stops.
+ **/
+
+struct column_reader {
+  unsigned char quote;
+  unsigned char token;
+  long column;
+  int ignore_headers;
+  int (*field_callback)(void *, size_t, void *);
+  void *data;
+
+  int past_header;
+  long current_column;
+  /* Whether a field of the current record was submitted */
+  int row_begun;
+
+  /* Unescaped copy of a quoted field with doubled quotes */
+  unsigned char *scratch;
+  size_t scratch_capacity;
+};
+
+static int is_term(unsigned char c) {
+  return c == '\r' || c == '\n';
+}
+
+/* libcsv's default spaces, except the delimiter always splits fields */
+static int is_space(unsigned char c, unsigned char token) {
+  return (c == ' ' || c == '\t') && c != token;
+}
+
+/* Sets a bit per byte of the block that is a quote or a possible separator */
+static void classify_block(const unsigned char *block, unsigned char quote,
+                           unsigned char token, uint64_t *quotes,
+                           uint64_t *separators) {
+#ifdef __SSE2__
+  __m128i quote_needle = _mm_set1_epi8((char)quote);
+  __m128i token_needle = _mm_set1_epi8((char)token);
+  __m128i cr_needle = _mm_set1_epi8('\r');
+  __m128i lf_needle = _mm_set1_epi8('\n');
+  int i;
+  *quotes = 0;
+  *separators = 0;
+  for (i = 0; i < BLOCK_SIZE / 16; ++i) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+    __m128i separator = _mm_or_si128(
+        _mm_cmpeq_epi8(chunk, token_needle),
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, cr_needle),
+                     _mm_cmpeq_epi8(chunk, lf_needle)));
+    *quotes |= (uint64_t)(unsigned int)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(chunk, quote_needle)) << (16 * i);
+    *separators |= (uint64_t)(unsigned int)_mm_movemask_epi8(separator)
+        << (16 * i);
+  }
+#else
+  int i;
+  *quotes = 0;
+  *separators = 0;
+  for (i = 0; i < BLOCK_SIZE; ++i) {
+    unsigned char c = block[i];
+    *quotes |= (uint64_t)(c == quote) << i;
+    *separators |= (uint64_t)(c == token || is_term(c)) << i;
+  }
+#endif
+}
+
+/* Bit i of the result is the XOR of bits 0 through i */
+static uint64_t prefix_xor(uint64_t bits) {
+#ifdef __PCLMUL__
+  /* A carry-less multiply by all ones computes every prefix at once */
+  __m128i product = _mm_clmulepi64_si128(
+      _mm_set_epi64x(0, (int64_t)bits), _mm_set1_epi8((char)0xFF), 0);
+  return (uint64_t)_mm_cvtsi128_si64(product);
+#else
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+#endif
+}
+
+static int trailing_zeros(uint64_t bits) {
+#ifdef __GNUC__
+  return __builtin_ctzll(bits);
+#else
+  int count = 0;
+  while ((bits & 1) == 0) {
+    bits >>= 1;
+    ++count;
+  }
+  return count;
+#endif
+}
+
+/* Returns the first set bit in [from, to) or to if there is none */
+static size_t next_bit(const uint64_t *bits, size_t from, size_t to) {
+  size_t word = from / BLOCK_SIZE;
+  uint64_t remaining;
+
+  if (from >= to) {
+    return to;
+  }
+  remaining = bits[word] & (~(uint64_t)0 << (from % BLOCK_SIZE));
+  while (remaining == 0) {
+    if (++word * BLOCK_SIZE >= to) {
+      return to;
+    }
+    remaining = bits[word];
+  }
+  from = word * BLOCK_SIZE + trailing_zeros(remaining);
+  return (from < to) ? from : to;
+}
+
+/**
+ * The quote parity cannot tell quotes and structural characters apart when
+ * they overlap, and libcsv skips a leading space or tab before checking for
+ * a quote. Those configurations are left to libcsv.
+ **/
+int dsv_can_index(unsigned char quote, unsigned char token) {
+  return quote != token && !is_term(quote) && !is_term(token) &&
+         quote != ' ' && quote != '\t';
+}
+
+/**
+ * Stage one. index must have room for (len + BLOCK_SIZE - 1) / BLOCK_SIZE
+ * words in both bitmaps.
+ **/
+void build_dsv_index(const unsigned char *buf, size_t len,
+                     unsigned char quote, unsigned char token,
+                     struct dsv_index *index) {
+  unsigned char tail[BLOCK_SIZE];
+  /* All ones while the previous block ended inside quotes */
+  uint64_t in_quotes = 0;
+  size_t block;
+
+  for (block = 0; block * BLOCK_SIZE < len; ++block) {
+    const unsigned char *bytes = buf + block * BLOCK_SIZE;
+    size_t remaining = len - block * BLOCK_SIZE;
+    uint64_t quotes, separators, quoted;
+
+    if (remaining < BLOCK_SIZE) {
+      memset(tail, 0, BLOCK_SIZE);
+      memcpy(tail, bytes, remaining);
+      bytes = tail;
+    }
+    classify_block(bytes, quote, token, &quotes, &separators);
+    if (remaining < BLOCK_SIZE) {
+      /* The padding may match a NUL quote or delimiter */
+      uint64_t valid = ((uint64_t)1 << remaining) - 1;
+      quotes &= valid;
+      separators &= valid;
+    }
+
+    quoted = prefix_xor(quotes) ^ in_quotes;
+    in_quotes = (uint64_t)0 - (quoted >> (BLOCK_SIZE - 1));
+    index->quotes[block] = quotes;
+    index->structurals[block] = separators & ~quoted;
+  }
+  index->len = len;
+}
+
+/* Copies the field without the first quote of every doubled quote */
+static unsigned char *unescape_field(struct column_reader *reader,
+                                     const unsigned char *field, size_t *len) {
+  size_t i, unescaped_len = 0;
+
+  if (*len > reader->scratch_capacity) {
+    unsigned char *new_ptr = realloc(reader->scratch, *len);
+    if (new_ptr == NULL) {
+      fprintf(stderr, "Error allocating a field of %lu bytes\n",
+              (unsigned long)*len);
+      return NULL;
+    }
+    reader->scratch = new_ptr;
+    reader->scratch_capacity = *len;
+  }
+  for (i = 0; i < *len; ++i) {
+    reader->scratch[unescaped_len++] = field[i];
+    if (field[i] == reader->quote) {
+      ++i;
+    }
+  }
+  *len = unescaped_len;
+  return reader->scratch;
+}
+
+/**
+ * Stage two for the field buf[start, end), where terminator is the delimiter
+ * or line terminator at end or -1 at the end of the file. Fields are trimmed
+ * and unescaped like libcsv and only the fields of the requested column past
+ * the header are passed to the callback, which stops parsing by returning
+ * non-zero.
+ **/
+static int submit_field(struct column_reader *reader, unsigned char *buf,
+    const struct dsv_index *index, size_t start, size_t end,
+    int terminator) {
+  unsigned char *value;
+  size_t pos = start, value_len;
+  int escaped = 0;
+
+  while (pos < end && is_space(buf[pos], reader->token)) {
+    ++pos;
+  }
+  if (pos == end && !reader->row_begun && terminator != reader->token) {
+    /* Blank lines are not records to libcsv */
+    return kDsvOk;
+  }
+
+  if (pos < end && buf[pos] == reader->quote) {
+    size_t quote = pos + 1, closing = end;
+    value = buf + pos + 1;
+    /**
+     * Only an unterminated field at the end of the file has no closing quote
+     * since the quote parity would otherwise hide its terminator.
+     **/
+    while ((quote = next_bit(index->quotes, quote, end)) < end) {
+      if (quote + 1 < end && buf[quote + 1] == reader->quote) {
+        escaped = 1;
+        quote += 2;
+      } else {
+        closing = quote;
+        break;
+      }
+    }
+    value_len = closing - (pos + 1);
+    /* Only spaces may follow the closing quote */
+    for (pos = closing + 1; pos < end; ++pos) {
+      if (!is_space(buf[pos], reader->token)) {
+        return kDsvParseError;
+      }
+    }
+  } else {
+    if (next_bit(index->quotes, pos, end) != end) {
+      /* Quote within an unquoted field */
+      return kDsvParseError;
+    }
+    value = buf + pos;
+    value_len = end - pos;
+    while (value_len > 0 && is_space(value[value_len - 1], reader->token)) {
+      --value_len;
+    }
+  }
+
+  if ((!reader->ignore_headers || reader->past_header) &&
+      reader->current_column == reader->column) {
+    if (escaped &&
+        (value = unescape_field(reader, value, &value_len)) == NULL) {
+      return kDsvMemoryError;
+    }
+    if (reader->field_callback(value, value_len, reader->data) != 0) {
+      return kDsvStopped;
+    }
+  }
+
+  ++reader->current_column;
+  reader->row_begun = 1;
+  if (terminator != reader->token) {
+    reader->past_header = 1;
+    reader->current_column = 0;
+    reader->row_begun = 0;
+  }
+  return kDsvOk;
+}
+
+static int grow_buffer(unsigned char **buf, struct dsv_index *index,
+                       size_t *capacity) {
+  size_t new_capacity = *capacity * 2;
+  size_t words = new_capacity / BLOCK_SIZE;
+  unsigned char *new_buf;
+  uint64_t *new_structurals, *new_quotes;
+
+  if (new_capacity < *capacity) {
+    fprintf(stderr, "Field is too large to index\n");
+    return kDsvMemoryError;
+  }
+  if ((new_buf = realloc(*buf, new_capacity)) != NULL) {
+    *buf = new_buf;
+  }
+  if ((new_structurals = realloc(index->structurals,
+                                 words * sizeof(uint64_t))) != NULL) {
+    index->structurals = new_structurals;
+  }
+  if ((new_quotes = realloc(index->quotes, words * sizeof(uint64_t))) != NULL) {
+    index->quotes = new_quotes;
+  }
+  if (new_buf == NULL || new_structurals == NULL || new_quotes == NULL) {
+    fprintf(stderr, "Error growing the DSV buffer to %lu bytes\n",
+            (unsigned long)new_capacity);
+    return kDsvMemoryError;
+  }
+  *capacity = new_capacity;
+  return kDsvOk;
+}
+
+/**
+ * Reads the file in READ_SIZE chunks, indexing and walking each. A field cut
+ * off by the end of a chunk is moved to the front of the buffer and indexed
+ * again with the next chunk, which starts it outside quotes as the previous
+ * field ended with a structural character. The buffer only grows while that
+ * field is shorter than DSV_MAX_FIELD_LEN.
+ **/
+int dsv_parse_column(FILE *file, unsigned char quote, unsigned char token,
+    long column, int ignore_headers,
+    int (*field_callback)(void *, size_t, void *), void *data) {
+  struct column_reader reader;
+  struct dsv_index index;
+  unsigned char *buf;
+  size_t capacity = READ_SIZE, len = 0, bytes_read;
+  int result = kDsvOk;
+
+  reader.quote = quote;
+  reader.token = token;
+  reader.column = column;
+  reader.ignore_headers = ignore_headers;
+  reader.field_callback = field_callback;
+  reader.data = data;
+  reader.past_header = 0;
+  reader.current_column = 0;
+  reader.row_begun = 0;
+  reader.scratch = NULL;
+  reader.scratch_capacity = 0;
+
+  buf = malloc(capacity);
+  index.structurals = malloc(capacity / BLOCK_SIZE * sizeof(uint64_t));
+  index.quotes = malloc(capacity / BLOCK_SIZE * sizeof(uint64_t));
+  if (buf == NULL || index.structurals == NULL || index.quotes == NULL) {
+    fprintf(stderr, "Error allocating the DSV buffer\n");
+    result = kDsvMemoryError;
+    goto done;
+  }
+
+  for (;;) {
+    size_t field_start = 0, structural;
+
+    if (len == capacity &&
+        (result = grow_buffer(&buf, &index, &capacity)) != kDsvOk) {
+      goto done;
+    }
+    if ((bytes_read = fread(buf + len, 1, capacity - len, file)) == 0) {
+      break;
+    }
+    len += bytes_read;
+
+    build_dsv_index(buf, len, quote, token, &index);
+    while ((structural = next_bit(index.structurals, field_start, len)) <
+           len) {
+      result = submit_field(&reader, buf, &index, field_start, structural,
+                            buf[structural]);
+      if (result != kDsvOk) {
+        goto done;
+      }
+      field_start = structural + 1;
+    }
+    memmove(buf, buf + field_start, len - field_start);
+    len -= field_start;
+    if (len > DSV_MAX_FIELD_LEN) {
+      result = kDsvFieldTooLong;
+      goto done;
+    }
+  }
+
+  if (ferror(file)) {
+    result = kDsvReadError;
+    goto done;
+  }
+  /* Like csv_fini, the last record needs no line terminator */
+  build_dsv_index(buf, len, quote, token, &index);
+  result = submit_field(&reader, buf, &index, 0, len, -1);
+
+done:
+  free(reader.scratch);
+  free(index.quotes);
+  free(index.structurals);
+  free(buf);
+  return result;
+}
+
+const char *dsv_strerror(int error) {
+  switch (error) {
+    case kDsvOk:
+      return "success";
+    case kDsvParseError:
+      /* Same wording as libcsv */
+      return "error parsing data while strict checking enabled";
+    case kDsvMemoryError:
+      return "memory exhausted while increasing buffer size";
+    case kDsvReadError:
+      return "error reading file";
+    case kDsvStopped:
+      return "parsing stopped by the field callback";
+    case kDsvFieldTooLong:
+      return "field longer than the maximum field length";
+    default:
+      return "unknown error";
+  }
+}
@@ -0,0 +1,7 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "dynamic_array.h"
+
+DEFINE_DYNAMIC_ARRAY(long, long)
+DEFINE_DYNAMIC_ARRAY(int32, int32_t)
+DEFINE_DYNAMIC_ARRAY(int64, int64_t)
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frozen_ids.h"
+#include "missing_id.h"
+
+/* A uint64_t takes at most 10 bytes as a varint */
+#define MAX_VARINT_LEN 10
+
+static const unsigned char frozen_header[FROZEN_IDS_HEADER_LEN] = {
+  'M', 'I', 'D', FROZEN_IDS_VERSION
+};
+
+struct varint_reader {
+  const unsigned char *bytes;
+  size_t len;
+  size_t pos;
+};
+
+static size_t write_varint(uint64_t value, unsigned char *out) {
+  size_t len = 0;
+  while (value >= 0x80) {
+    out[len++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  out[len++] = (unsigned char)value;
+  return len;
+}
+
+/* Returns 0 or 1 if the varint is truncated or too long */
+static int read_varint(struct varint_reader *reader, uint64_t *value) {
+  unsigned int shift = 0;
+  *value = 0;
+  while (reader->pos < reader->len && shift < 7 * MAX_VARINT_LEN) {
+    unsigned char byte = reader->bytes[reader->pos++];
+    *value |= (uint64_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return 0;
+    }
+    shift += 7;
+  }
+  return 1;
+}
+
+static uint64_t zigzag(int64_t value) {
+  return (value < 0) ? ~((uint64_t)value << 1) : (uint64_t)value << 1;
+}
+
+static int64_t unzigzag(uint64_t value) {
+  return (value & 1) ? (int64_t)~(value >> 1) : (int64_t)(value >> 1);
+}
+
+static int compare_int64(const void *a, const void *b) {
+  int64_t lhs = *(const int64_t *)a;
+  int64_t rhs = *(const int64_t *)b;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+/**
+ * Sorts a copy of the IDs and encodes them. The id_array itself is untouched
+ * so it may be freed afterwards to keep only the frozen form. The caller owns
+ * the bytes and frees them with free.
+ **/
+struct frozen_ids freeze_ids(const struct id_array *ids, int *err_no) {
+  struct frozen_ids frozen;
+  size_t len = id_array_len(ids);
+  size_t unique, i;
+  int64_t *sorted;
+
+  frozen.bytes = NULL;
+  frozen.len = 0;
+  *err_no = 0;
+
+  sorted = malloc((len + 1) * sizeof(int64_t));
+  if (sorted == NULL) {
+    fprintf(stderr, "Failed allocating %lu IDs to freeze\n",
+            (unsigned long)len);
+    *err_no = 1;
+    return frozen;
+  }
+  for (i = 0; i < len; ++i) {
+    sorted[i] = (ids->width == kWidth32) ? ids->narrow.array[i]
+                                         : ids->wide.array[i];
+  }
+  qsort(sorted, len, sizeof(int64_t), compare_int64);
+
+  for (i = 0, unique = 0; i < len; ++i) {
+    if (unique == 0 || sorted[i] != sorted[unique - 1]) {
+      sorted[unique++] = sorted[i];
+    }
+  }
+
+  /* Upper bound, shrunk once the real length is known */
+  frozen.bytes = malloc(FROZEN_IDS_HEADER_LEN + (unique + 1) * MAX_VARINT_LEN);
+  if (frozen.bytes == NULL) {
+    fprintf(stderr, "Failed allocating frozen IDs\n");
+    free(sorted);
+    *err_no = 1;
+    return frozen;
+  }
+
+  memcpy(frozen.bytes, frozen_header, FROZEN_IDS_HEADER_LEN);
+  frozen.len = FROZEN_IDS_HEADER_LEN;
+  frozen.len += write_varint((uint64_t)unique, frozen.bytes + frozen.len);
+  for (i = 0; i < unique; ++i) {
+    uint64_t value = (i == 0)
+        ? zigzag(sorted[0])
+        : (uint64_t)sorted[i] - (uint64_t)sorted[i - 1] - 1;
+    frozen.len += write_varint(value, frozen.bytes + frozen.len);
+  }
+  free(sorted);
+
+  {
+    unsigned char *shrunk = realloc(frozen.bytes, frozen.len);
+    if (shrunk != NULL) {
+      frozen.bytes = shrunk;
+    }
+  }
+  return frozen;
+}
+
+/**
+ * Walks the sorted IDs until the first gap above 0, so unlike missing_number
+ * it neither needs to decode nor modify the set. Matches missing_number: IDs
+ * below 1 are ignored and the answer is 1 past the run starting at 1.
+ **/
+long frozen_missing_number(const unsigned char *bytes, size_t len,
+                           int *err_no) {
+  struct varint_reader reader;
+  uint64_t count, value, i;
+  int64_t id = 0;
+  long expected = 1;
+
+  if (len < FROZEN_IDS_HEADER_LEN ||
+      memcmp(bytes, frozen_header, FROZEN_IDS_HEADER_LEN) != 0) {
+    fprintf(stderr, "Bytes are not frozen IDs of version %d\n",
+            FROZEN_IDS_VERSION);
+    *err_no = kFrozenNotFrozen;
+    return 0;
+  }
+
+  reader.bytes = bytes;
+  reader.len = len;
+  reader.pos = FROZEN_IDS_HEADER_LEN;
+  *err_no = kFrozenOk;
+
+  if (read_varint(&reader, &count) != 0) {
+    *err_no = kFrozenCorrupted;
+  }
+  for (i = 0; i < count && *err_no == 0; ++i) {
+    if (read_varint(&reader, &value) != 0) {
+      *err_no = kFrozenCorrupted;
+      break;
+    }
+    id = (i == 0) ? unzigzag(value) : (int64_t)((uint64_t)id + value + 1);
+    if (id > expected) {
+      break;
+    } else if (id == expected) {
+      ++expected;
+    }
+  }
+
+  if (*err_no != 0) {
+    fprintf(stderr, "Frozen IDs are truncated or corrupted\n");
+  }
+  return expected;
+}
@@ -2,7 +2,8 @@
 #include <string.h>
 #include <stdlib.h>
 
-#include "dynamic_long_array.h"
+#include "archive_stats.h"
+#include "dynamic_array.h"
 #include "missing_id.h"
 
 /**
@@ -43,6 +44,18 @@ static struct argp_option options[] = {
   { "input", 'i', "INPUT_FILE(s)", 0, "File(s) to search through" },
   { "columns", 'c', "ID COLUMN #", 0,
     "Column that has the ID (default first column)" },
+  { "stats", 's', 0, 0,
+    "Print archive statistics as JSON instead of the missing ID" },
+  { "block-size", 'b', "SIZE", 0,
+    "Number of IDs per histogram block in --stats (default 10000)" },
+  { "character-column", 'n', "COLUMN #", 0,
+    "Column that has the character name in --stats (default 5)" },
+  { "time-column", 't', "COLUMN #", 0,
+    "Column that has the roll time in --stats (default 8)" },
+  { "width", 'w', "auto|32|64", 0,
+    "Width of the stored IDs (default auto: 32-bit unless an ID overflows)" },
+  { "lenient", 'l', 0, 0,
+    "Keep malformed quotes as text instead of failing (slower parser)" },
   { 0 }
 };
 
@@ -60,6 +73,14 @@ struct arguments {
   int ignore_headers;
   char *output;
 
+  int width;
+  int strict;
+
+  int stats;
+  long block_size;
+  long character_column;
+  long time_column;
+
   size_t input_file_length;
   size_t column_specify_length;
   char **input;
@@ -83,6 +104,14 @@ parse_opt (int key, char *arg, struct argp_state *state) {
       arguments->ignore_headers = 0;
       arguments->output = NULL;
 
+      arguments->width = MISSING_ID_WIDTH;
+      arguments->strict = 1;
+
+      arguments->stats = 0;
+      arguments->block_size = 10000;
+      arguments->character_column = 5;
+      arguments->time_column = 8;
+
       arguments->input = NULL;
       arguments->columns = NULL;
       arguments->input_file_length = 0;
@@ -123,6 +152,42 @@ parse_opt (int key, char *arg, struct argp_state *state) {
     case 'h':
       arguments->ignore_headers = 1;
       break;
+    case 'w':
+      if (strcmp(arg, "auto") == 0) {
+        arguments->width = kWidthAuto;
+      } else if (strcmp(arg, "32") == 0) {
+        arguments->width = kWidth32;
+      } else if (strcmp(arg, "64") == 0) {
+        arguments->width = kWidth64;
+      } else {
+        FreeArguments(arguments);
+        argp_error(state, "Width must be one of auto, 32 or 64");
+      }
+      break;
+    case 'l':
+      arguments->strict = 0;
+      break;
+    case 's':
+      arguments->stats = 1;
+      break;
+    case 'b': case 'n': case 't':
+    {
+      char *end;
+      long num = strtol(arg, &end, 10);
+      if (*arg == '\0' || *end != '\0' || num < 0 ||
+          (key == 'b' && num == 0)) {
+        FreeArguments(arguments);
+        argp_error(state, "Block size and columns must be numeric");
+      }
+      if (key == 'b') {
+        arguments->block_size = num;
+      } else if (key == 'n') {
+        arguments->character_column = num;
+      } else {
+        arguments->time_column = num;
+      }
+      break;
+    }
     case 'o':
       /* Prevent empty input. Otherwise, any file name would be valid */
       arguments->output = arg;
@@ -231,25 +296,54 @@ static struct argp argp = { options, parse_opt, arg_docs, doc };
 
 int main(int argc, char *argv[]) {
   struct arguments arguments;
-  struct dynamic_long_array dynamic_array;
+  struct id_array ids;
   int ret_val = 0;
 
   argp_parse( &argp, argc, argv, 0, 0, &arguments );
 
-  dynamic_array = compile_ids_from_files((const char* const *)arguments.input,
+  if (arguments.stats) {
+    struct archive_stats_options options;
+    struct archive_stats stats;
+    char *json = NULL;
+
+    options.character_column = arguments.character_column;
+    options.time_column = arguments.time_column;
+    options.block_size = arguments.block_size;
+    options.quote = arguments.quote;
+    options.token = arguments.token;
+    options.strict = arguments.strict;
+
+    stats = compile_stats_from_files((const char* const *)arguments.input,
+        arguments.columns, arguments.input_file_length,
+        arguments.ignore_headers, &options, &ret_val);
+    if (ret_val == 0) {
+      json = archive_stats_to_json(&stats,
+          (const char* const *)arguments.input, &ret_val);
+    }
+    if (ret_val == 0) {
+      printf("%s\n", json);
+    }
+
+    free(json);
+    free_archive_stats(&stats);
+    FreeArguments(&arguments);
+    exit(ret_val == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  ids = compile_compact_ids_from_files((const char* const *)arguments.input,
       arguments.columns, arguments.input_file_length, arguments.ignore_headers,
-      arguments.quote, arguments.token, 100, &ret_val);
+      arguments.quote, arguments.token, arguments.strict, arguments.width,
+      &ret_val);
   if (ret_val != 0) {
     FreeArguments(&arguments);
-    free_dynamic_long_array(&dynamic_array);
+    free_id_array(&ids);
     exit(EXIT_FAILURE);
   }
-  printf("Missing id: %ld\n", missing_number(dynamic_array.array,
-        dynamic_array.len));
+  printf("Missing id: %ld\n", id_array_missing_number(&ids));
 
   FreeArguments(&arguments);
 
-  free_dynamic_long_array(&dynamic_array);
+  free_id_array(&ids);
 
   exit(EXIT_SUCCESS);
 }
@@ -3,102 +3,178 @@
 #include <string.h>
 
 #include "missing_id.h"
-#include "dynamic_long_array.h"
+#include "dynamic_array.h"
+#include "dsv_index.h"
 #include "csv.h"
 
-long missing_number(long *array, size_t len) {
-  /**
-   * Define n = array_len and [-1, k] to be the range of elements.
-   * We allow [-1, 0] to be in the range for different ways to track missing IDs
-   * but are not considered valid IDs for the missing number
-   * Solution requirements:
-   * - Must be performed without changing the already allocated array
-   * - Preferably, without sorting. Sorting would provide an easier
-   *   implementation but will result in a minimum O(nlog(n)) time. 
-   * - k (known >200k) will be much larger than n (likely <1000) in its initial
-   *   iterations, meaning radix sort would not be a suitable option.
-   * Solution:
-   * - Push all non-positive values to the left of the array and keep track of
-   *   index of the first positive value (unused for the original intended
-   *   problem)
-   * - Take the subarray of only positive values as arr_{pos} and the length of
-   *   the subarray is n_{pos}.
-   * - Iterate through arr_{pos} such that if 1 <= abs(elem) <= n_{pos}, then
-   *   arr_{pos}[abs(elem)-1] will go from positive to negative. The absolute
-   *   value is used since we know all elements in the subarray were intended
-   *   to be positive but might be made into negatives.
-   * - Iterate through arr_{pos} again such that if elem > 0, then that
-   *   idx(elem) must not have been found in arr_{pos}. Since we subtract by 1
-   *   earlier to constrain the range of indices edited from [0, n_{pos}], we
-   *   should add by one again in order to understand what abs(elem) was not
-   *   found in the array.
-   * - If all values in the positive array was made negative, then it should be
-   *   safe to assume that all positive numbers [1, n_{pos}] were found such
-   *   that the smallest missing positive number was n_{pos} + 1;
-   * - We can then reiterate through arr_{pos} and then set them back to
-   *   positive. This takes O(1) space, O(n) time.
-   **/
-  
-  size_t i = 0;
-  size_t first_pos = 0;
-  size_t minimum_missing_positive;
-  /* Push all of the non-positive numbers to the left */
-  for (i = 0; i < len; ++i) {
-    if (array[i] < 1) {
-      long tmp = array[i];
-      array[i] = array[first_pos];
-      /**
-       * We increment the first_pos after making the last_non_pos or first_pos-1
-       * into a negative.
-       **/
-      array[first_pos++] = tmp;
-    }
- }
+/**
+ * Define n = array_len and [-1, k] to be the range of elements.
+ * We allow [-1, 0] to be in the range for different ways to track missing IDs
+ * but are not considered valid IDs for the missing number
+ * Solution requirements:
+ * - Must be performed without changing the already allocated array
+ * - Preferably, without sorting. Sorting would provide an easier
+ *   implementation but will result in a minimum O(nlog(n)) time. 
+ * - k (known >200k) will be much larger than n (likely <1000) in its initial
+ *   iterations, meaning radix sort would not be a suitable option.
+ * Solution:
+ * - Push all non-positive values to the left of the array and keep track of
+ *   index of the first positive value (unused for the original intended
+ *   problem)
+ * - Take the subarray of only positive values as arr_{pos} and the length of
+ *   the subarray is n_{pos}.
+ * - Iterate through arr_{pos} such that if 1 <= abs(elem) <= n_{pos}, then
+ *   arr_{pos}[abs(elem)-1] will go from positive to negative. The absolute
+ *   value is used since we know all elements in the subarray were intended
+ *   to be positive but might be made into negatives.
+ * - Iterate through arr_{pos} again such that if elem > 0, then that
+ *   idx(elem) must not have been found in arr_{pos}. Since we subtract by 1
+ *   earlier to constrain the range of indices edited from [0, n_{pos}], we
+ *   should add by one again in order to understand what abs(elem) was not
+ *   found in the array.
+ * - If all values in the positive array was made negative, then it should be
+ *   safe to assume that all positive numbers [1, n_{pos}] were found such
+ *   that the smallest missing positive number was n_{pos} + 1;
+ * - We can then reiterate through arr_{pos} and then set them back to
+ *   positive. This takes O(1) space, O(n) time.
+ *
+ * The algorithm is generated for every ID width by DEFINE_MISSING_NUMBER.
+ **/
+#define DEFINE_MISSING_NUMBER(NAME, TYPE)                                      \
+  long NAME(TYPE *array, size_t len) {                                        \
+    size_t i = 0;                                                             \
+    size_t first_pos = 0;                                                     \
+    size_t minimum_missing_positive;                                          \
+    /* Push all of the non-positive numbers to the left */                    \
+    for (i = 0; i < len; ++i) {                                               \
+      if (array[i] < 1) {                                                     \
+        TYPE tmp = array[i];                                                  \
+        array[i] = array[first_pos];                                          \
+        /**                                                                   \
+         * We increment the first_pos after making the last_non_pos or        \
+         * first_pos-1 into a negative.                                       \
+         **/                                                                  \
+        array[first_pos++] = tmp;                                             \
+      }                                                                       \
+    }                                                                         \
+                                                                              \
+    for (i = first_pos; i < len; ++i) {                                       \
+      /* Elem should always be at least 1. */                                 \
+      TYPE elem = (array[i] > 0) ? array[i] : -array[i];                      \
+                                                                              \
+      /* Keep the index within the index range */                             \
+      if (elem + first_pos - 1 < len && array[elem + first_pos - 1] > 0) {    \
+        array[elem + first_pos - 1] *= -1;                                    \
+      }                                                                       \
+    }                                                                         \
+                                                                              \
+    minimum_missing_positive = len - first_pos + 1;                           \
+    for (i = first_pos; i < len; ++i) {                                       \
+      /**                                                                     \
+       * If the elmeent at index i is still positive, it was not found in the \
+       * array                                                                \
+       **/                                                                    \
+      if (array[i] > 0 && minimum_missing_positive == len - first_pos + 1) {  \
+        minimum_missing_positive = i - first_pos + 1;                         \
+      }                                                                       \
+      /* Reset the array to the previous state */                             \
+      if (array[i] < 0) {                                                     \
+        array[i] *= -1;                                                       \
+      }                                                                       \
+    }                                                                         \
+    return minimum_missing_positive;                                          \
+  }
 
-  /* unsigned int pos_len = len - first_pos; */
-  for (i = first_pos; i < len; ++i) {
-    /* Elem should always be at least 1. */
-    long elem = (array[i] > 0) ? array[i] : -array[i];
-    /* An interesting way to keep the shift active */
+DEFINE_MISSING_NUMBER(missing_number, long)
+DEFINE_MISSING_NUMBER(missing_number_int32, int32_t)
+DEFINE_MISSING_NUMBER(missing_number_int64, int64_t)
 
-    /* Keep the index within the index range */
-    if (elem + first_pos - 1 < len && array[elem + first_pos - 1] > 0) {
-      array[elem + first_pos - 1] *= -1;
-    }
+struct id_array create_id_array(int width, size_t initial_capacity,
+                                int *err_no) {
+  struct id_array ids;
+
+  ids.fixed = (width != kWidthAuto);
+  ids.width = (width == kWidth64) ? kWidth64 : kWidth32;
+  ids.narrow = create_dynamic_int32_array(
+      (ids.width == kWidth32) ? initial_capacity : 0, err_no);
+  if (*err_no != 0) {
+    ids.wide = create_dynamic_int64_array(0, err_no);
+    *err_no = 1;
+    return ids;
   }
+  ids.wide = create_dynamic_int64_array(
+      (ids.width == kWidth64) ? initial_capacity : 0, err_no);
+  return ids;
+}
 
-  minimum_missing_positive = len - first_pos + 1;
-  for (i = first_pos; i < len; ++i) {
-    /**
-     * If the elmeent at index i is still positive, it was not found in the
-     * array
-     **/
-    if (array[i] > 0 && minimum_missing_positive == len - first_pos + 1) {
-      minimum_missing_positive = i - first_pos + 1;
-    }
-    /* Reset the array to the previous state */
-    if (array[i] < 0) {
-      array[i] *= -1;
+/* Copies the 32-bit IDs into the 64-bit array the first time one overflows */
+static int widen_id_array(struct id_array *ids) {
+  size_t i;
+  int err_no;
+
+  free_dynamic_int64_array(&ids->wide);
+  ids->wide = create_dynamic_int64_array(ids->narrow.capacity * 2, &err_no);
+  if (err_no != 0) {
+    return err_no;
+  }
+  for (i = 0; i < ids->narrow.len; ++i) {
+    ids->wide.array[i] = ids->narrow.array[i];
+  }
+  ids->wide.len = ids->narrow.len;
+  free_dynamic_int32_array(&ids->narrow);
+  ids->narrow.array = NULL;
+  ids->narrow.len = 0;
+  ids->narrow.capacity = 0;
+  ids->width = kWidth64;
+  return 0;
+}
+
+int append_id(long element, struct id_array *ids) {
+  if (ids->width == kWidth32) {
+    if (element >= INT32_MIN && element <= INT32_MAX) {
+      return append_int32((int32_t)element, &ids->narrow);
+    } else if (ids->fixed) {
+      fprintf(stderr, "ID %ld does not fit in a 32-bit ID array\n", element);
+      return 2;
+    } else {
+      int result = widen_id_array(ids);
+      if (result != 0) {
+        return result;
+      }
     }
   }
-  return minimum_missing_positive;
-} 
+  return append_int64((int64_t)element, &ids->wide);
+}
+
+size_t id_array_len(const struct id_array *ids) {
+  return (ids->width == kWidth32) ? ids->narrow.len : ids->wide.len;
+}
+
+long id_array_missing_number(struct id_array *ids) {
+  if (ids->width == kWidth32) {
+    return missing_number_int32(ids->narrow.array, ids->narrow.len);
+  }
+  return missing_number_int64(ids->wide.array, ids->wide.len);
+}
+
+void free_id_array(struct id_array *ids) {
+  free_dynamic_int32_array(&ids->narrow);
+  free_dynamic_int64_array(&ids->wide);
+}
 
 /**
  * We use the strtol function here which requires a null terminating character.
- * Therefore, do NOT use it without specifying the CSV_APPEND_NULL option
+ * Therefore, the field is copied before parsing it. Errors are kept in the
+ * parser info so parsing can be stopped and reported through err_no rather
+ * than exiting, which would take down the process using the addon.
  **/
-void field_callback(void *s, size_t len, void *data) {
-  int retval;
-  struct parser_info *info = (struct parser_info *)data;
+static int append_field_id(void *s, size_t len, struct parser_info *info) {
+  long value;
   /* Potential concern?: overflow of size_t */
   char *str;
-  if ((info->ignore_headers && !info->past_header) ||
-       info->current_column++ != info->id_column) {
-    return;
-  } else if ((str = calloc(len+1, sizeof(char))) == NULL) {
+  if ((str = calloc(len+1, sizeof(char))) == NULL) {
     fprintf(stderr, "Error occurred while allocating string\n");
-    exit(EXIT_FAILURE);
+    return info->error = 1;
   }
 
   /**
@@ -106,17 +182,39 @@ void field_callback(void *s, size_t len, void *data) {
    * strtol will return 0 when it reaches the header as long as the header does
    * not start with a numeric value\
    **/
-  strncpy(str, (char *) s, len);
-  retval = append(strtol(str, NULL, 10), info->array);
+  if (s != NULL) {
+    /* CSV_EMPTY_IS_NULL passes empty unquoted fields as NULL */
+    strncpy(str, (char *) s, len);
+  }
+  value = strtol(str, NULL, 10);
+  info->error = (info->ids != NULL) ? append_id(value, info->ids)
+                                    : append_long(value, info->array);
   free(str);
 
-  if (retval != 0) {
-    free_dynamic_long_array(info->array);
-    fprintf(stderr, "Some error occurred while reading a field: %d\n", retval);
-    exit(EXIT_FAILURE);
+  if (info->error != 0) {
+    fprintf(stderr, "Some error occurred while reading a field: %d\n",
+        info->error);
   }
+  return info->error;
 }
 
+void field_callback(void *s, size_t len, void *data) {
+  struct parser_info *info = (struct parser_info *)data;
+  /* libcsv cannot be stopped from a callback, so skip the rest instead */
+  if (info->error != 0 || (info->ignore_headers && !info->past_header) ||
+       info->current_column++ != info->id_column) {
+    return;
+  }
+  append_field_id(s, len, info);
+}
+
+#ifndef MISSING_ID_LIBCSV
+/* dsv_parse_column only passes the ID column past the header */
+static int id_field_callback(void *s, size_t len, void *data) {
+  return append_field_id(s, len, (struct parser_info *)data);
+}
+#endif
+
 void record_callback(int c, void *data) {
   /**
    * c here is either the line terminator unsigned char or -1 if the final
@@ -127,61 +225,126 @@ void record_callback(int c, void *data) {
   info->current_column = 0;
 }  
 
-struct dynamic_long_array compile_ids_from_files(const char* const* filenames,
-    const long *columns, size_t len, int ignore_headers, unsigned char quote,
-    unsigned char token, size_t starting_capacity, int *err_no) {  
-  struct dynamic_long_array dynamic_array;
+/**
+ * Parses every file into the array of the given parser info, which is reset
+ * for each file. Returns 0 or the err_no of compile_ids_from_files: 1 if the
+ * parser could not be created, 2 if a file could not be opened, 3 if a file
+ * is malformed and 4 if an ID could not be stored, e.g. because it does not
+ * fit the requested width.
+ *
+ * Without strict, stray quotes are kept as text like libcsv does without
+ * CSV_STRICT, which only libcsv parses, so the two-stage parser is skipped.
+ **/
+static int parse_id_files(const char* const* filenames, const long *columns,
+    size_t len, int ignore_headers, unsigned char quote, unsigned char token,
+    int strict, struct parser_info *parser_info) {
   struct csv_parser p;
   char buf[1024];
   size_t bytes_read, i;
 
-  *err_no = 0;
-  dynamic_array = create_dynamic_long_array(starting_capacity, err_no);
-  if (*err_no != 0) {
-    return dynamic_array;
-  }
-
-  if (csv_init(&p, CSV_STRICT & CSV_APPEND_NULL & CSV_EMPTY_IS_NULL) != 0) {
+  if (csv_init(&p, (strict ? CSV_STRICT : 0) | CSV_APPEND_NULL |
+                   CSV_EMPTY_IS_NULL) != 0) {
     fprintf(stderr, "Error creating csv parser\n");
-    *err_no = 1;
-    return dynamic_array;
+    return 1;
   }
   csv_set_delim(&p, token);
   csv_set_quote(&p, quote);
+  parser_info->error = 0;
 
   for (i = 0; i < len; ++i) {
-    struct parser_info parser_info;
     FILE *file;
 
-    parser_info.array = &dynamic_array;
-    parser_info.ignore_headers = ignore_headers;
-    parser_info.id_column = columns[i];
-    parser_info.past_header = 0;
-    parser_info.current_column = 0;
+    parser_info->ignore_headers = ignore_headers;
+    parser_info->id_column = columns[i];
+    parser_info->past_header = 0;
+    parser_info->current_column = 0;
     /* filenames should be null terminated */
     file = fopen(filenames[i], "r");
     if (file == NULL) {
       fprintf(stderr, "Error opening file: %s\n", filenames[i]);
-      *err_no = 2;
       csv_free(&p);
-      return dynamic_array;
+      return 2;
+    }
+#ifndef MISSING_ID_LIBCSV
+    if (strict && dsv_can_index(quote, token)) {
+      int result = dsv_parse_column(file, quote, token, columns[i],
+          ignore_headers, id_field_callback, parser_info);
+      fclose(file);
+      if (result == kDsvStopped) {
+        csv_free(&p);
+        return 4;
+      } else if (result != kDsvOk) {
+        fprintf(stderr, "Error while parsing file: %s\n",
+            dsv_strerror(result));
+        csv_free(&p);
+        return 3;
+      }
+      continue;
     }
+#endif
     while ((bytes_read=fread(buf, 1, 1024, file)) > 0) {
       if (csv_parse(&p, buf, bytes_read, field_callback, record_callback,
-            &parser_info) != bytes_read) {
+            parser_info) != bytes_read) {
         fprintf(stderr, "Error while parsing file: %s\n",
             csv_strerror(csv_error(&p)));
-        *err_no = 3;
         fclose(file);
         csv_free(&p);
-        return dynamic_array;
+        return 3;
+      }
+      if (parser_info->error != 0) {
+        break;
       }
     }
     fclose(file);
-    csv_fini(&p, field_callback, record_callback, &parser_info);
+    csv_fini(&p, field_callback, record_callback, parser_info);
     csv_free(&p);
+    if (parser_info->error != 0) {
+      return 4;
+    }
   }
 
   csv_free(&p);
+  return 0;
+}
+
+struct dynamic_long_array compile_ids_from_files(const char* const* filenames,
+    const long *columns, size_t len, int ignore_headers, unsigned char quote,
+    unsigned char token, int strict, size_t starting_capacity, int *err_no) {
+  struct dynamic_long_array dynamic_array;
+  struct parser_info parser_info;
+
+  *err_no = 0;
+  dynamic_array = create_dynamic_long_array(starting_capacity, err_no);
+  if (*err_no != 0) {
+    return dynamic_array;
+  }
+
+  parser_info.array = &dynamic_array;
+  parser_info.ids = NULL;
+  *err_no = parse_id_files(filenames, columns, len, ignore_headers, quote,
+      token, strict, &parser_info);
   return dynamic_array;
 }
+
+/**
+ * Same as compile_ids_from_files but stores the IDs with the given IdWidth,
+ * which halves the memory of the IDs whenever they all fit in 32 bits.
+ **/
+struct id_array compile_compact_ids_from_files(const char* const* filenames,
+    const long *columns, size_t len, int ignore_headers, unsigned char quote,
+    unsigned char token, int strict, int width, int *err_no) {
+  struct id_array ids;
+  struct parser_info parser_info;
+
+  *err_no = 0;
+  ids = create_id_array(width, 128, err_no);
+  if (*err_no != 0) {
+    return ids;
+  }
+
+  parser_info.array = NULL;
+  parser_info.ids = &ids;
+  *err_no = parse_id_files(filenames, columns, len, ignore_headers, quote,
+      token, strict, &parser_info);
+  return ids;
+}
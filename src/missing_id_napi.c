@@ -1,10 +1,20 @@
+#include <limits.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <node_api.h>
-#include "dynamic_long_array.h"
+#include "archive_stats.h"
+#include "dynamic_array.h"
+#include "frozen_ids.h"
 #include "missing_id.h"
 
+/**
+ * Throws an error for a failed call (unless one is already pending) and
+ * returns cb from the calling function, so nothing runs with the outputs of
+ * the failed call.
+ **/
 #define NAPI_CALL(env, call, cb)                                      \
   do {                                                                \
     napi_status status = (call);                                      \
@@ -19,8 +29,8 @@
             ? "empty error message"                                   \
             : err_message;                                            \
         napi_throw_error((env), NULL, message);                       \
-        (cb);                                                         \
       }                                                               \
+      return (cb);                                                    \
     }                                                                 \
   } while(0)
 
@@ -32,10 +42,165 @@ void util_free_filename_array(char **array, size_t len) {
   free(array);
 }
 
+/**
+ * Reads a single-character string argument. Returns false with a pending
+ * exception if the argument is not exactly one character.
+ **/
+static bool util_get_char(napi_env env, napi_value value, char *out) {
+  size_t field_len;
+  char str[2];
+
+  if (napi_get_value_string_utf8(env, value, NULL, 0, &field_len) != napi_ok) {
+    napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE", "Expected a string.");
+    return false;
+  }
+  if (field_len != 1) {
+    napi_throw_error(env, "ERR_INVALID_ARG_VALUE",
+        "Quote and delimiter fields must be exactly one character");
+    return false;
+  }
+  napi_get_value_string_utf8(env, value, str, 2 * sizeof(char), NULL);
+  *out = str[0];
+  return true;
+}
+
+/**
+ * Copies a JS array of filenames into a heap array of null terminated strings
+ * that must be freed with util_free_filename_array. Returns NULL with a
+ * pending exception on failure.
+ **/
+static char **util_get_filename_array(napi_env env, napi_value value,
+    uint32_t *num_of_files) {
+  bool is_array;
+  char **files;
+
+  if (napi_is_array(env, value, &is_array) != napi_ok || !is_array) {
+    napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+        "Does not pass in an Array of filenames.");
+    return NULL;
+  }
+  napi_get_array_length(env, value, num_of_files);
+
+  files = calloc(*num_of_files + 1, sizeof(char *));
+  if (files == NULL) {
+    napi_throw_error(env, "ERR_MEMORY_ALLOCATION_FAILED",
+        "Failed to allocate memory for filenames");
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < *num_of_files; ++i) {
+    napi_value element;
+    size_t strlen;
+
+    if (napi_get_element(env, value, i, &element) != napi_ok ||
+        napi_get_value_string_utf8(env, element, NULL, 0, &strlen) != napi_ok) {
+      napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+          "Filenames must be strings.");
+      util_free_filename_array(files, *num_of_files);
+      return NULL;
+    }
+    files[i] = calloc(strlen + 1, sizeof(char));
+    if (files[i] == NULL) {
+      napi_throw_error(env, "ERR_MEMORY_ALLOCATION_FAILED",
+          "Failed to memory for string buffer on heap");
+      util_free_filename_array(files, *num_of_files);
+      return NULL;
+    }
+    napi_get_value_string_utf8(env, element, files[i],
+        (strlen + 1) * sizeof(char), NULL);
+  }
+  return files;
+}
+
+/**
+ * Reads the optional number property of an options object into out, which is
+ * left untouched when the property is undefined. Returns false with a pending
+ * exception if the property is not an integer within [min, LONG_MAX].
+ **/
+static bool util_get_long_option(napi_env env, napi_value options,
+    const char *name, long min, long *out) {
+  napi_value value;
+  napi_valuetype type;
+  int64_t number;
+  char message[96];
+
+  if (napi_get_named_property(env, options, name, &value) != napi_ok ||
+      napi_typeof(env, value, &type) != napi_ok) {
+    napi_throw_error(env, NULL, "Failed to read the options.");
+    return false;
+  }
+  if (type == napi_undefined) {
+    return true;
+  }
+  if (type != napi_number ||
+      napi_get_value_int64(env, value, &number) != napi_ok) {
+    sprintf(message, "Option %.32s must be a number.", name);
+    napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE", message);
+    return false;
+  }
+  if (number < min || number > LONG_MAX) {
+    sprintf(message, "Option %.32s must be at least %ld.", name, min);
+    napi_throw_range_error(env, "ERR_OUT_OF_RANGE", message);
+    return false;
+  }
+  *out = (long)number;
+  return true;
+}
+
+/**
+ * Reads the optional boolean property of an options object like
+ * util_get_long_option.
+ **/
+static bool util_get_bool_option(napi_env env, napi_value options,
+    const char *name, int *out) {
+  napi_value value;
+  napi_valuetype type;
+  bool flag;
+  char message[96];
+
+  if (napi_get_named_property(env, options, name, &value) != napi_ok ||
+      napi_typeof(env, value, &type) != napi_ok) {
+    napi_throw_error(env, NULL, "Failed to read the options.");
+    return false;
+  }
+  if (type == napi_undefined) {
+    return true;
+  }
+  if (type != napi_boolean ||
+      napi_get_value_bool(env, value, &flag) != napi_ok) {
+    sprintf(message, "Option %.32s must be a boolean.", name);
+    napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE", message);
+    return false;
+  }
+  *out = flag;
+  return true;
+}
+
 static void free_arraybuffer(napi_env env, void *data, void *hint) {
   free(data);
 }
 
+/**
+ * Moves the ownership of data to a new external ArrayBuffer. The data is freed
+ * and false is returned with a pending exception if it could not be created.
+ **/
+static bool util_wrap_arraybuffer(napi_env env, void *data, size_t len,
+    napi_value *arraybuffer) {
+  if (napi_create_external_arraybuffer(env, data, len, free_arraybuffer, NULL,
+                                       arraybuffer) != napi_ok) {
+    free(data);
+    napi_throw_error(env, "ERR_MEMORY_ALLOCATION_FAILED",
+        "Failed to create an ArrayBuffer for the IDs");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * missingID(ids) accepts a BigInt64Array (returns a BigInt), an Int32Array or
+ * a Uint8Array of frozen IDs from freezeIDs (both return a Number). Any other
+ * Uint8Array is rejected by the header of the frozen IDs.
+ **/
 static napi_value napi_missing_number(napi_env env, napi_callback_info info) {
   size_t argc = 1;
   napi_value argv[1];
@@ -45,7 +210,7 @@ static napi_value napi_missing_number(napi_env env, napi_callback_info info) {
   bool is_typedarray;
   napi_typedarray_type underlying_type;
   size_t length;
-  long* array;
+  void *array;
 
   NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL), NULL);
 
@@ -60,150 +225,308 @@ static napi_value napi_missing_number(napi_env env, napi_callback_info info) {
     return NULL;
   }
 
-  NAPI_CALL(env, napi_get_typedarray_info(env, argv[0], &underlying_type, &length, (void **)&array, NULL, NULL), NULL);
-  if (underlying_type != napi_bigint64_array) {
-    NAPI_CALL(env, napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE", "TypedArray is not of BigInt64."), NULL);
-    return NULL;
+  NAPI_CALL(env, napi_get_typedarray_info(env, argv[0], &underlying_type, &length, &array, NULL, NULL), NULL);
+  switch (underlying_type) {
+    case napi_bigint64_array:
+      NAPI_CALL(env, napi_create_bigint_uint64(env, missing_number((long *)array, length), &result), NULL);
+      break;
+    case napi_int32_array:
+      NAPI_CALL(env, napi_create_int64(env, missing_number_int32((int32_t *)array, length), &result), NULL);
+      break;
+    case napi_uint8_array:
+    {
+      int err_no;
+      long missing = frozen_missing_number((const unsigned char *)array, length, &err_no);
+      if (err_no == kFrozenNotFrozen) {
+        napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE", "Uint8Array does not hold frozen IDs from freezeIDs.");
+        return NULL;
+      } else if (err_no != kFrozenOk) {
+        napi_throw_error(env, "ERR_INVALID_ARG_VALUE", "Frozen IDs are truncated or corrupted.");
+        return NULL;
+      }
+      NAPI_CALL(env, napi_create_int64(env, missing, &result), NULL);
+      break;
+    }
+    default:
+      NAPI_CALL(env, napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE", "TypedArray is not of BigInt64, Int32 or frozen Uint8."), NULL);
+      return NULL;
   }
-
-  NAPI_CALL(env, napi_create_bigint_uint64(env, missing_number(array, length), &result), NULL);
   return result;
 }
 
+/**
+ * compileIDs(files, quote, delimiter[, width[, strict]]) returns the IDs in an
+ * Int32Array when they all fit (or width is 32) and a BigInt64Array otherwise
+ * (or when width is 64). The width defaults to MISSING_ID_WIDTH. Malformed
+ * quotes fail unless strict is false, like ./main --lenient.
+ **/
 static napi_value napi_compile_ids(napi_env env, napi_callback_info info) {
-  size_t argc = 3;
-  napi_value argv[3];
-  /* Used to check if an argument is a correct type */
-  bool correct_type;
-  /* Used for building arguments for native function */
-  uint32_t num_of_files;
-  /* long columns[num_of_files]; */
-  /* char *files[num_of_files]; */
-
-  /* Used quote and delimiter string fields */
-  size_t field_len;
+  size_t argc = 5;
+  napi_value argv[5];
   char quote;
   char delimiter;
+  uint32_t num_of_files;
+  char **files;
+  long *columns;
+  int32_t width = MISSING_ID_WIDTH;
+  bool strict = true;
 
   /* Used for native add-on call and returning function */
   int err_no;
-  napi_value long_arraybuffer;
+  struct id_array ids;
+  napi_value arraybuffer;
   napi_value result;
-  napi_finalize finalizer;
 
   NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL), NULL);
 
-  if (argc != 3) {
+  if (argc < 3) {
     NAPI_CALL(env, napi_throw_error(env, "ERR_MISSING_ARGS", "Incorrect number of args provided."), NULL);
     return NULL;
   }
+  if (!util_get_char(env, argv[1], &quote) ||
+      !util_get_char(env, argv[2], &delimiter)) {
+    return NULL;
+  }
+  if (argc > 3) {
+    napi_valuetype type;
+    NAPI_CALL(env, napi_typeof(env, argv[3], &type), NULL);
+    if (type != napi_undefined) {
+      NAPI_CALL(env, napi_get_value_int32(env, argv[3], &width), NULL);
+      if (width != kWidthAuto && width != kWidth32 && width != kWidth64) {
+        napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+            "Width must be 0 (auto), 32 or 64.");
+        return NULL;
+      }
+    }
+  }
+  if (argc > 4) {
+    napi_valuetype type;
+    NAPI_CALL(env, napi_typeof(env, argv[4], &type), NULL);
+    if (type != napi_undefined) {
+      NAPI_CALL(env, napi_get_value_bool(env, argv[4], &strict), NULL);
+    }
+  }
 
-  /* Begin processing second argument: Quote character */
-
-  /* Will throw an error since there is no napi_string check */
-  NAPI_CALL(env, napi_get_value_string_utf8(env, argv[1], NULL, 0, &field_len), NULL);
-  if (field_len != 1) {
-    /* If the argument is not a single character */
-    NAPI_CALL(env, napi_throw_error(env, "ERR_INVALID_ARG_VALUE",
-        "Quote field must be exactly one character"), NULL);
+  /* Must use a normal Array since there is no typedarray for strings */
+  if ((files = util_get_filename_array(env, argv[0], &num_of_files)) == NULL) {
+    return NULL;
+  }
+  if ((columns = calloc(num_of_files + 1, sizeof(long))) == NULL) {
+    util_free_filename_array(files, num_of_files);
+    napi_throw_error(env, "ERR_MEMORY_ALLOCATION_FAILED",
+        "Failed to allocate memory for columns");
+    return NULL;
   }
 
-  char str[2];
-  NAPI_CALL(env, napi_get_value_string_utf8(env, argv[1], str,
-      2 * sizeof(char), NULL), NULL);
-  quote = str[0];
+  ids = compile_compact_ids_from_files((const char * const *)files, columns,
+      num_of_files, 0, (unsigned char)quote, (unsigned char)delimiter, strict,
+      width, &err_no);
 
-  /* Begin processing second argument: Delimiter character */
+  free(columns);
+  util_free_filename_array(files, num_of_files);
 
-  /* Will throw an error since there is no napi_string check */
-  NAPI_CALL(env, napi_get_value_string_utf8(env, argv[2], NULL, 0, &field_len), NULL);
-  if (field_len != 1) {
-    /* If the argument is not a single character */
-    NAPI_CALL(env, napi_throw_error(env, "ERR_INVALID_ARG_VALUE",
-        "Quote field must be exactly one character"), NULL);
+  if (err_no != 0) {
+    free_id_array(&ids);
+    napi_throw_error(env, "ERR_OPERATION_FAILED",
+        "Failed to compile the IDs from the files");
     return NULL;
   }
 
-  NAPI_CALL(env, napi_get_value_string_utf8(env, argv[2], str,
-      2 * sizeof(char), NULL), NULL);
-  delimiter = str[0];
+  /**
+   * I think these calls result in a pointer being directed towards somewhere
+   * in the middle of the arraybuffer resulting in valgrind reporting a 
+   * it being possibly lost. It might be that we look at the byte_offset 0
+   * and the length and other attributes of the arraybuffer are accessed
+   * relative to some position in the arraybuffer.
+   *
+   * Ownership of the used array moves to the arraybuffer, the other is freed.
+   **/
+  if (ids.width == kWidth32) {
+    free_dynamic_int64_array(&ids.wide);
+    if (!util_wrap_arraybuffer(env, (void *)ids.narrow.array,
+        ids.narrow.len * sizeof(int32_t), &arraybuffer)) {
+      return NULL;
+    }
+    NAPI_CALL(env, napi_create_typedarray(env, napi_int32_array, ids.narrow.len,
+        arraybuffer, 0, &result), NULL);
+  } else {
+    free_dynamic_int32_array(&ids.narrow);
+    if (!util_wrap_arraybuffer(env, (void *)ids.wide.array,
+        ids.wide.len * sizeof(int64_t), &arraybuffer)) {
+      return NULL;
+    }
+    NAPI_CALL(env, napi_create_typedarray(env, napi_bigint64_array, ids.wide.len,
+        arraybuffer, 0, &result), NULL);
+  }
+
+  return result;
+}
+
+/**
+ * freezeIDs(ids) encodes an Int32Array or BigInt64Array of IDs into the
+ * sorted delta/varint form of frozen_ids.h and returns it as a Uint8Array,
+ * which missingID accepts directly.
+ **/
+static napi_value napi_freeze_ids(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  bool is_typedarray;
+  napi_typedarray_type underlying_type;
+  size_t length;
+  void *array;
 
+  struct id_array view;
+  struct frozen_ids frozen;
+  int err_no;
+  napi_value arraybuffer;
+  napi_value result;
 
-  /* Begin processing first argument: array of filenames */
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL), NULL);
 
-  NAPI_CALL(env, napi_is_array(env, argv[0], &correct_type), NULL);
-  if (!correct_type) {
-    NAPI_CALL(env, napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE", "Does not pass in a TypedArray for argument 0."), NULL);
+  if (argc != 1) {
+    NAPI_CALL(env, napi_throw_error(env, "ERR_MISSING_ARGS", "Incorrect number of args provided."), NULL);
+    return NULL;
   }
-  /* Must use a normal Array since there is no typedarray for strings */
-  NAPI_CALL(env, napi_get_array_length(env, argv[0], &num_of_files), NULL);
 
-  char **files = calloc(num_of_files, sizeof(char *));
-  long columns[num_of_files];
+  NAPI_CALL(env, napi_is_typedarray(env, argv[0], &is_typedarray), NULL);
+  if (!is_typedarray) {
+    NAPI_CALL(env, napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE", "Does not pass in a TypedArray."), NULL);
+    return NULL;
+  }
+  NAPI_CALL(env, napi_get_typedarray_info(env, argv[0], &underlying_type, &length, &array, NULL, NULL), NULL);
+
+  /* A read-only id_array over the TypedArray's memory */
+  memset(&view, 0, sizeof(view));
+  view.fixed = 1;
+  if (underlying_type == napi_int32_array) {
+    view.width = kWidth32;
+    view.narrow.array = (int32_t *)array;
+    view.narrow.len = length;
+  } else if (underlying_type == napi_bigint64_array) {
+    view.width = kWidth64;
+    view.wide.array = (int64_t *)array;
+    view.wide.len = length;
+  } else {
+    NAPI_CALL(env, napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE", "TypedArray is not of BigInt64 or Int32."), NULL);
+    return NULL;
+  }
 
-  /**
-   * The highest possible index is 2^32 - 2 since the max array length
-   * is 2^32 - 1. Thus preventing overflows as we will always be less
-   * than MAX_UINT32.
-   **/
-  for (uint32_t i = 0; i < num_of_files; ++i) {
-    napi_handle_scope scope;
-    napi_value element;
-    size_t strlen;
-    char *str;
-    columns[i] = 0;
+  frozen = freeze_ids(&view, &err_no);
+  if (err_no != 0) {
+    napi_throw_error(env, "ERR_MEMORY_ALLOCATION_FAILED", "Failed to freeze the IDs");
+    return NULL;
+  }
+
+  if (!util_wrap_arraybuffer(env, (void *)frozen.bytes, frozen.len,
+                             &arraybuffer)) {
+    return NULL;
+  }
+  NAPI_CALL(env, napi_create_typedarray(env, napi_uint8_array, frozen.len,
+      arraybuffer, 0, &result), NULL);
+  return result;
+}
+
+/**
+ * archiveStats(files, quote, delimiter[, options]) returns the archive
+ * statistics of the files as a JSON string in a single pass over the files.
+ * The options mirror the flags of ./main --stats: blockSize (-b),
+ * characterColumn (-n), timeColumn (-t), headers (-h) and strict (false for
+ * -l). They default to the crawler's column layout (ID 0, character 5 and
+ * time 8) without headers and with strict parsing. A number is taken as the
+ * blockSize.
+ **/
+static napi_value napi_archive_stats(napi_env env, napi_callback_info info) {
+  size_t argc = 4;
+  napi_value argv[4];
+  char quote;
+  char delimiter;
+  uint32_t num_of_files;
+  char **files;
+  long *columns;
+  int ignore_headers = 0;
 
-    NAPI_CALL(env, napi_open_handle_scope(env, &scope), util_free_filename_array(
-        files, num_of_files));
+  struct archive_stats_options options;
+  struct archive_stats stats;
+  char *json = NULL;
+  int err_no;
+  napi_value result = NULL;
 
-    NAPI_CALL(env, napi_get_element(env, argv[0], i, &element), util_free_filename_array(
-        files, num_of_files));
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL), NULL);
 
-    NAPI_CALL(env, napi_get_value_string_utf8(env, element, NULL, 0, &strlen),
-        util_free_filename_array(files, num_of_files));
+  if (argc < 3) {
+    napi_throw_error(env, "ERR_MISSING_ARGS", "Incorrect number of args provided.");
+    return NULL;
+  }
+  if (!util_get_char(env, argv[1], &quote) ||
+      !util_get_char(env, argv[2], &delimiter)) {
+    return NULL;
+  }
 
-    str = calloc(strlen + 1, sizeof(char));
-    if (str == NULL) {
-      NAPI_CALL(env, napi_throw_error(env, "ERR_MEMORY_ALLOCATION_FAILED",
-          "Failed to memory for string buffer on heap"), util_free_filename_array(
-              files, num_of_files));
+  options.character_column = 5;
+  options.time_column = 8;
+  options.block_size = 10000;
+  options.quote = (unsigned char)quote;
+  options.token = (unsigned char)delimiter;
+  options.strict = 1;
+  if (argc > 3) {
+    napi_valuetype type;
+    int64_t block_size;
+    NAPI_CALL(env, napi_typeof(env, argv[3], &type), NULL);
+    if (type == napi_number) {
+      NAPI_CALL(env, napi_get_value_int64(env, argv[3], &block_size), NULL);
+      if (block_size <= 0 || block_size > LONG_MAX) {
+        napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+            "Block size must be positive.");
+        return NULL;
+      }
+      options.block_size = (long)block_size;
+    } else if (type == napi_object) {
+      if (!util_get_long_option(env, argv[3], "blockSize", 1,
+                                &options.block_size) ||
+          !util_get_long_option(env, argv[3], "characterColumn", 0,
+                                &options.character_column) ||
+          !util_get_long_option(env, argv[3], "timeColumn", 0,
+                                &options.time_column) ||
+          !util_get_bool_option(env, argv[3], "headers", &ignore_headers) ||
+          !util_get_bool_option(env, argv[3], "strict", &options.strict)) {
+        return NULL;
+      }
+    } else if (type != napi_undefined) {
+      napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+          "Options must be an object or a block size.");
+      return NULL;
     }
+  }
+  if ((files = util_get_filename_array(env, argv[0], &num_of_files)) == NULL) {
+    return NULL;
+  }
+  if ((columns = calloc(num_of_files + 1, sizeof(long))) == NULL) {
+    util_free_filename_array(files, num_of_files);
+    napi_throw_error(env, "ERR_MEMORY_ALLOCATION_FAILED",
+        "Failed to allocate memory for columns");
+    return NULL;
+  }
 
-    /* Always appends a null terminator expected for relevant functions */
-    NAPI_CALL(env, napi_get_value_string_utf8(env, element,
-        str, (strlen+1) * sizeof(char), NULL), util_free_filename_array(
-            files, num_of_files));
-    
-    files[i] = str;
-    NAPI_CALL(env, napi_close_handle_scope(env, scope), util_free_filename_array(
-        files, num_of_files));
+  stats = compile_stats_from_files((const char * const *)files, columns,
+      num_of_files, ignore_headers, &options, &err_no);
+  if (err_no == 0) {
+    json = archive_stats_to_json(&stats, (const char * const *)files, &err_no);
   }
 
-  struct dynamic_long_array dynamic_array = 
-      compile_ids_from_files((const char * const *)files, columns, num_of_files, 0, (unsigned char)quote,
-          (unsigned char)delimiter, 0, &err_no);
-  
-  util_free_filename_array(files, num_of_files);
-  
   if (err_no != 0) {
-    NAPI_CALL(env, napi_throw_error(env, "ERR_OPERATION_FAILED",
-        "Failed to initialize the csv parser"), free_dynamic_long_array(&dynamic_array));
+    napi_throw_error(env, "ERR_OPERATION_FAILED",
+        "Failed to compile archive statistics");
+  } else if (napi_create_string_utf8(env, json, NAPI_AUTO_LENGTH,
+                                     &result) != napi_ok) {
+    napi_throw_error(env, "ERR_OPERATION_FAILED",
+        "Failed to create the JSON string");
+    result = NULL;
   }
-  
-  /**
-   * I think these calls result in a pointer being directed towards somewhere
-   * in the middle of the arraybuffer resulting in valgrind reporting a 
-   * it being possibly lost. It might be that we look at the byte_offset 0
-   * and the length and other attributes of the arraybuffer are accessed
-   * relative to some position in the arraybuffer.
-   **/
-  NAPI_CALL(env, napi_create_external_arraybuffer(env, (void *)dynamic_array.array, 
-      dynamic_array.len * sizeof(long), free_arraybuffer, NULL,
-      &long_arraybuffer), NULL);
-
-  NAPI_CALL(env, napi_create_typedarray(env, napi_bigint64_array, dynamic_array.len,
-      long_arraybuffer, 0, &result), NULL);
 
+  free(json);
+  free(columns);
+  free_archive_stats(&stats);
+  util_free_filename_array(files, num_of_files);
   return result;
 }
 
@@ -211,6 +534,8 @@ NAPI_MODULE_INIT() {
   napi_property_descriptor bindings[] = {
     {"missingID", NULL, napi_missing_number, NULL, NULL, NULL, napi_default_method, NULL},
     {"compileIDs", NULL, napi_compile_ids, NULL, NULL, NULL, napi_default_method, NULL},
+    {"freezeIDs", NULL, napi_freeze_ids, NULL, NULL, NULL, napi_default_method, NULL},
+    {"archiveStats", NULL, napi_archive_stats, NULL, NULL, NULL, napi_default_method, NULL},
   };
 
   NAPI_CALL(env, napi_define_properties(env, exports, sizeof(bindings) / sizeof(napi_property_descriptor), bindings), NULL);
@@ -4,17 +4,21 @@
 // the malformed html but would require more processing in the longterm.
 // const htmlparser2 = require('htmlparser2');
 const cheerio = require('cheerio');
-const fs = require('fs');
 const path = require('path');
+const { BatchedFileWriter, durability_policies } = require('./writer.js');
+const { GapScheduler } = require('./scheduler.js');
 
 /* How often to crawl (with a variance) and update in milliseconds*/
 const crawl_interval = 5 * 60 * 1000;
 const crawl_interval_variance = 45 * 1000;
 
 // We need to use different URLs to query and forms depending on the data
-// we use to query.
-const id_query_url = 'http://cydel.net/idlook.php';
-const character_query_url = 'http://cydel.net/dicelook.php';
+// we use to query. The paths are resolved against the base URL so the crawler
+// can be pointed at a local fixture server (see bench/fixture_server.js).
+const default_base_url = 'http://cydel.net';
+// Relative so a path prefix of --base-url (e.g. a mirror) is kept
+const id_query_path = 'idlook.php';
+const character_query_path = 'dicelook.php';
 
 // CSS Selectors to select the table and relevant attributes in the table
 // Character and id selectors must be used in context of the table
@@ -34,25 +38,41 @@ const headers = {
  **/
 const my_addon = require('../build/Release/addon.node');
 
+/**
+ * Resolves a page of the perma-roller against the base URL. The base URL is
+ * treated as a directory even without a trailing slash.
+ * @param {string} page_path Relative path of the page
+ * @param {string} base_url The server to query
+ * @returns {URL}
+ */
+function queryURL(page_path, base_url) {
+  const base = new URL(base_url);
+  if (!base.pathname.endsWith('/')) {
+    base.pathname += '/';
+  }
+  return new URL(page_path, base);
+}
+
 /**
  * Queries the perma-roller for the roll(s) with the specified key attributes.
  * @param {string} type The type of query to be executed
  * @param {string} key  The key value of the query
+ * @param {string} base_url The server to query
  * @returns
  */
-async function queryRolls(type, key) {
+async function queryRolls(type, key, base_url = default_base_url) {
   let url, request_body;
 
   switch (type) {
     case 'id':
-      url = id_query_url;
+      url = queryURL(id_query_path, base_url);
       request_body = {
         name: key,
         search: 'Search ID!',
       };
       break;
     case 'character':
-      url = character_query_url;
+      url = queryURL(character_query_path, base_url);
       request_body = {
         name: key,
         'lets roll!': 'Search!',
@@ -68,14 +88,34 @@ async function queryRolls(type, key) {
     headers: headers,
     body: new URLSearchParams(request_body),
   });
+  // Error pages must not be mistaken for a query that found no rolls
+  if (!response.ok) {
+    throw Error(`${url} responded with status ${response.status}`);
+  }
   const response_text = await response.text();
   return response_text;
 }
 
+/**
+ * Selects the results table, which is present even when no rolls matched.
+ * @param {CheerioAPI} $ The loaded response
+ * @returns {Cheerio} The results table
+ * @throws {Error} If the response has no results table
+ */
+function selectResultsTable($) {
+  const table = $(table_selector);
+  if (table.length === 0) {
+    throw Error('Response has no results table');
+  }
+  return table;
+}
+
 /**
  * Extract the character from the query using the roll ID.
  * @param {string} response The HTML response of the query. May be malformed.
- * @returns {string} The name of the character who made the ID
+ * @returns {string} The name of the character who made the ID, or null if the
+ *     results table has no roll
+ * @throws {Error} If the response has no results table
  */
 function extractCharacterFromIDQuery(response) {
   // Load the response using cheerio's parser5 (which is HTML-5 compliant
@@ -84,7 +124,7 @@ function extractCharacterFromIDQuery(response) {
 
   // We use .html() here since some characters may have html in them: such as
   // the "Pacman ghosts".
-  return $(table_selector).find(character_selector).html();
+  return selectResultsTable($).find(character_selector).html();
 }
 
 /**
@@ -93,8 +133,9 @@ function extractCharacterFromIDQuery(response) {
  * @param {text} response The HTML response of the query. May be malformed.
  * @param {quote: string, delimiter: string} format_opts An object
  *     containing options for formatting the DSV
- * @param {Array<BigInt64>} running_ids A mutable array of the found ids
+ * @param {Array<number|BigInt>} running_ids A mutable array of the found ids
  * @returns {dsv} The rolls formatted in the DSV.
+ * @throws {Error} If the response has no results table
  */
 function createDSVFromCharacterQuery(response, format_opts, running_ids) {
   // Selects the table to iterate the rows of
@@ -107,7 +148,7 @@ function createDSVFromCharacterQuery(response, format_opts, running_ids) {
   let dsv = '';
   let col_no = 0;
 
-  $(table_selector)
+  selectResultsTable($)
     .find(rolls_selector)
     .children('td')
     .each((_idx, elem) => {
@@ -158,42 +199,80 @@ function createDSVFromCharacterQuery(response, format_opts, running_ids) {
   return dsv;
 }
 
+/**
+ * Packs the found IDs into the narrowest TypedArray accepted by missingID.
+ * Int32Array halves the memory and avoids converting every ID to a BigInt.
+ * @param {Array<number|string|BigInt>} ids The found ids
+ * @returns {Int32Array|BigInt64Array}
+ */
+function toIDTypedArray(ids) {
+  const int32_max = 2147483647;
+  const fits_int32 = ids.every((id) => {
+    const num = Number(id);
+    return num <= int32_max && num >= -int32_max - 1;
+  });
+  return fits_int32
+    ? Int32Array.from(ids, Number)
+    : BigInt64Array.from(ids, BigInt);
+}
+
+/**
+ * Thrown by crawl when the results table has no roll with the ID, as opposed
+ * to the query failing or returning an error page.
+ */
+class RollNotFoundError extends Error {}
+
 /**
  * Finds the character who owns the ID and then returns a DSV-formatted
  * string of all of the character's rolls.
  * @param {number} id The lowest missing ID to query for the character's rolls.
  * @param {quote: string, delimiter: string} format_opts An object containing
  *     format options for the DSV format.
- * @param {Array<BigInt64>} running_ids A mutable array of the found ids
+ * @param {Array<number|BigInt>} running_ids A mutable array of the found ids
+ * @param {string} base_url The server to query
  * @returns {character: string, dsv: string} Rolls formatted in a DSV
  */
-async function crawl(id, format_opts, running_ids) {
+async function crawl(id, format_opts, running_ids, base_url) {
   let html_response;
   try {
-    html_response = await queryRolls('id', id);
+    html_response = await queryRolls('id', id, base_url);
   } catch (e) {
     console.error('Error: ', e);
     /* Done to propogate fetch errors */
     throw `Error when fetching roll with ID ${id}`;
   }
 
-  const id_query_results = extractCharacterFromIDQuery(html_response);
+  let id_query_results;
+  try {
+    id_query_results = extractCharacterFromIDQuery(html_response);
+  } catch (e) {
+    console.error('Error: ', e);
+    throw `Unexpected response when fetching roll with ID ${id}`;
+  }
 
-  /* Character will be undefined if no roll with ID was found*/
-  if (typeof id_query_results === 'undefined') {
-    throw `Error: Roll with ID ${id} not found.`;
+  /* Character will be null (or undefined) if the table has no roll with ID */
+  if (id_query_results === null || typeof id_query_results === 'undefined') {
+    throw new RollNotFoundError(`Roll with ID ${id} not found.`);
   }
 
   try {
-    html_response = await queryRolls('character', id_query_results);
+    html_response = await queryRolls('character', id_query_results, base_url);
   } catch (e) {
     console.error('Error: ', e);
-    throw `Error when fetching rolls with character ${character}`;
+    throw `Error when fetching rolls with character ${id_query_results}`;
+  }
+
+  let dsv;
+  try {
+    dsv = createDSVFromCharacterQuery(html_response, format_opts, running_ids);
+  } catch (e) {
+    console.error('Error: ', e);
+    throw `Unexpected response for rolls with character ${id_query_results}`;
   }
 
   return {
     character: id_query_results,
-    dsv: createDSVFromCharacterQuery(html_response, format_opts, running_ids),
+    dsv: dsv,
   };
 }
 
@@ -211,8 +290,20 @@ function handleCLIArgs(argv) {
    * Else, --output should be a singular file
    **/
   const minimist_settings = {
-    string: ['input', 'quote', 'delimiter', 'base-dir', 'output'],
-    boolean: ['separate-character-files'],
+    string: [
+      'input',
+      'quote',
+      'delimiter',
+      'base-dir',
+      'output',
+      'block-size',
+      'durability',
+      'max-open-files',
+      'flush-delay',
+      'base-url',
+      'state',
+    ],
+    boolean: ['separate-character-files', 'stats', 'lenient'],
     alias: {
       i: 'input',
       o: 'output',
@@ -225,6 +316,14 @@ function handleCLIArgs(argv) {
       quote: '"',
       delimiter: '\t',
       'separate-character-files': false,
+      stats: false,
+      lenient: false,
+      'block-size': '10000',
+      durability: 'none',
+      'max-open-files': '64',
+      'flush-delay': '0',
+      'base-url': default_base_url,
+      state: 'crawl_state.json',
       'base-dir': '.',
     },
     unknown: (param) => {
@@ -248,6 +347,28 @@ function handleCLIArgs(argv) {
         'Expected single-character ASCII delimiter field, got: ' +
         minimist_arguments['delimiter'].toString()
       );
+    } else if (!/^[1-9][0-9]*$/.test(minimist_arguments['block-size'])) {
+      throw (
+        'Expected positive integer block size, got: ' +
+        minimist_arguments['block-size'].toString()
+      );
+    } else if (
+      !durability_policies.includes(minimist_arguments['durability'])
+    ) {
+      throw (
+        `Expected durability in ${durability_policies.join('|')}, got: ` +
+        minimist_arguments['durability'].toString()
+      );
+    } else if (!/^[1-9][0-9]*$/.test(minimist_arguments['max-open-files'])) {
+      throw (
+        'Expected positive integer for max open files, got: ' +
+        minimist_arguments['max-open-files'].toString()
+      );
+    } else if (!/^[0-9]+$/.test(minimist_arguments['flush-delay'])) {
+      throw (
+        'Expected non-negative integer flush delay, got: ' +
+        minimist_arguments['flush-delay'].toString()
+      );
     } else if (Array.isArray(minimist_arguments['output'])) {
       throw (
         'Expected single output destination, got: ' +
@@ -255,6 +376,15 @@ function handleCLIArgs(argv) {
       );
     }
 
+    try {
+      new URL(minimist_arguments['base-url']);
+    } catch (e) {
+      throw (
+        'Expected absolute base URL, got: ' +
+        minimist_arguments['base-url'].toString()
+      );
+    }
+
     const input = [];
 
     if (Array.isArray(minimist_arguments['input'])) {
@@ -292,6 +422,17 @@ function handleCLIArgs(argv) {
       output_type: minimist_arguments['separate-character-files']
         ? 'directory'
         : 'file',
+      stats: minimist_arguments['stats'],
+      strict: !minimist_arguments['lenient'],
+      block_size: Number(minimist_arguments['block-size']),
+      durability: minimist_arguments['durability'],
+      max_open_files: Number(minimist_arguments['max-open-files']),
+      flush_delay: Number(minimist_arguments['flush-delay']),
+      base_url: minimist_arguments['base-url'],
+      state_file: path.resolve(
+        minimist_arguments['base-dir'],
+        minimist_arguments['state']
+      ),
     };
   } catch (e) {
     console.error(e);
@@ -307,11 +448,31 @@ function main() {
     return;
   }
 
+  if (user_args['stats']) {
+    // Statistics are computed natively in one pass and returned as JSON. The
+    // crawler writes a header line to every file it creates.
+    console.log(
+      my_addon.archiveStats(
+        user_args['input_files'],
+        user_args['quote'],
+        user_args['delimiter'],
+        {
+          blockSize: user_args['block_size'],
+          headers: true,
+          strict: user_args['strict'],
+        }
+      )
+    );
+    return;
+  }
+
   const running_ids = Array.from(
     my_addon.compileIDs(
       user_args['input_files'],
       user_args['quote'],
-      user_args['delimiter']
+      user_args['delimiter'],
+      undefined,
+      user_args['strict']
     )
   );
   const format_opts = {
@@ -333,51 +494,99 @@ function main() {
 
   const dsv_header = value_headers.join(format_opts['delimiter']) + '\n';
 
+  // Keeps character files open between crawls and writes the header to new
+  // files as part of their first batch. Each crawl writes a single chunk, so
+  // chunks are only coalesced across crawls with a --flush-delay longer than
+  // the crawl interval.
+  const writer = new BatchedFileWriter({
+    header: dsv_header,
+    max_open_files: user_args['max_open_files'],
+    flush_delay: user_args['flush_delay'],
+    durability: user_args['durability'],
+  });
+  process.once('SIGINT', () => {
+    clearTimeout(workflow);
+    writer.close().finally(() => process.exit(130));
+  });
+
+  const scheduler = new GapScheduler({
+    interval: crawl_interval,
+    interval_variance: crawl_interval_variance,
+    state_file: user_args['state_file'],
+  });
+
   // We use nested timeouts in order to ensure that there are at least
-  // crawl_interval milliseconds
-  let previous_missing_id = -1;
+  // crawl_interval milliseconds (varied and backed off by the scheduler)
   let iteration = 0;
-  let workflow = setTimeout(async function work() {
+  let workflow;
+  async function work() {
+    scheduler.update(running_ids);
+    const target_id = scheduler.next();
+    const started = Date.now();
     try {
-      const missing_id = my_addon
-        .missingID(BigInt64Array.from(running_ids))
-        .toString();
-      if (missing_id === previous_missing_id) {
-        throw 'Same ID is still missing';
-      }
-      const crawl_results = await crawl(missing_id, format_opts, running_ids);
+      const crawl_results = await crawl(
+        target_id,
+        format_opts,
+        running_ids,
+        user_args['base_url']
+      );
       const output_file =
         user_args['output_type'] === 'directory'
           ? path.resolve(user_args['output'], crawl_results['character'])
           : user_args['output'];
-      previous_missing_id = missing_id;
-      fs.promises
-        .access(output_file, fs.constants.F_OK)
-        .catch((err) => {
-          // If the file does not exist, then we want to append headers
-          fs.appendFile(output_file, dsv_header, (err) => {
-            if (err) throw err;
-          });
-        })
-        .finally(() => {
-          // After appending headers, we append all of the results of the file
-          fs.appendFile(output_file, crawl_results['dsv'], (err) => {
-            if (err) throw err;
-          });
-        });
-      // TODO: Add in something to vary the crawl_interval
-      workflow = setTimeout(work, crawl_interval);
-      console.log(`iteration: ${++iteration} complete`);
+      writer.write(output_file, crawl_results['dsv']).catch((err) => {
+        console.error(`Error writing to ${output_file}: `, err);
+      });
+      scheduler.recordSuccess(Date.now() - started, target_id);
+      // The character's rolls should include the ID that led to them. If not,
+      // skip the ID rather than querying it forever.
+      if (!running_ids.some((id) => Number(id) === Number(target_id))) {
+        scheduler.recordNotFound(target_id);
+      }
+    } catch (e) {
+      if (e instanceof RollNotFoundError) {
+        console.log(e.message);
+        scheduler.recordNotFound(target_id);
+      } else {
+        console.error(e);
+        scheduler.recordFailure(target_id);
+      }
+    }
+
+    try {
+      await scheduler.save();
     } catch (e) {
-      // Stops the nested timeout
-      clearTimeout(workflow);
-      throw e;
+      console.error('Error saving scheduler state: ', e);
     }
-  }, 0);
+    workflow = setTimeout(work, scheduler.nextDelay());
+    console.log(`iteration: ${++iteration} complete`);
+  }
+
+  scheduler.load().then(
+    () => {
+      workflow = setTimeout(work, 0);
+    },
+    (e) => {
+      console.error(e);
+      writer.close();
+    }
+  );
 }
 
 // ids.forEach((elem) => {
 //   console.log(elem);
 // });
 
-main();
+if (require.main === module) {
+  main();
+}
+
+module.exports = {
+  queryRolls: queryRolls,
+  extractCharacterFromIDQuery: extractCharacterFromIDQuery,
+  createDSVFromCharacterQuery: createDSVFromCharacterQuery,
+  crawl: crawl,
+  RollNotFoundError: RollNotFoundError,
+  toIDTypedArray: toIDTypedArray,
+  my_addon: my_addon,
+};
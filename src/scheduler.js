@@ -0,0 +1,421 @@
+const fs = require('fs');
+
+/**
+ * Binary max-heap ordered by the score of its items.
+ */
+class MaxHeap {
+  constructor(items = [], score = (item) => item['score']) {
+    this.score = score;
+    this.items = items;
+    // Heapify bottom-up in O(n)
+    for (let i = (this.items.length >> 1) - 1; i >= 0; --i) {
+      this.siftDown(i);
+    }
+  }
+
+  get size() {
+    return this.items.length;
+  }
+
+  push(item) {
+    this.items.push(item);
+    let i = this.items.length - 1;
+    while (i > 0) {
+      const parent = (i - 1) >> 1;
+      if (this.score(this.items[parent]) >= this.score(this.items[i])) {
+        break;
+      }
+      this.swap(i, parent);
+      i = parent;
+    }
+  }
+
+  pop() {
+    if (this.items.length === 0) {
+      return undefined;
+    }
+    const top = this.items[0];
+    const last = this.items.pop();
+    if (this.items.length > 0) {
+      this.items[0] = last;
+      this.siftDown(0);
+    }
+    return top;
+  }
+
+  siftDown(i) {
+    const len = this.items.length;
+    for (;;) {
+      const left = 2 * i + 1;
+      const right = left + 1;
+      let largest = i;
+      if (
+        left < len &&
+        this.score(this.items[left]) > this.score(this.items[largest])
+      ) {
+        largest = left;
+      }
+      if (
+        right < len &&
+        this.score(this.items[right]) > this.score(this.items[largest])
+      ) {
+        largest = right;
+      }
+      if (largest === i) {
+        return;
+      }
+      this.swap(i, largest);
+      i = largest;
+    }
+  }
+
+  swap(i, j) {
+    const tmp = this.items[i];
+    this.items[i] = this.items[j];
+    this.items[j] = tmp;
+  }
+}
+
+/**
+ * Decides which ID to crawl next and how long to wait before doing so.
+ *
+ * Gaps between the found IDs are kept in a max-heap scored by their size and
+ * how long they have been open, so large and old gaps are crawled first
+ * instead of always the lowest missing ID. IDs the server reports as not
+ * found are confirmed absent and treated as found, so a deleted roll no
+ * longer stalls the crawl. IDs whose crawl failed max_failures times in a row
+ * are skipped as well, so neither can a page that always fails. The pause
+ * between crawls is jittered and backs off while responses are slow or
+ * failing. The absent IDs, the failures, the age of the gaps and the backoff
+ * are saved to the state file so a restart resumes immediately.
+ */
+class GapScheduler {
+  /**
+   * @param {{interval: number, interval_variance: number,
+   *     slow_threshold: number, max_backoff: number, size_weight: number,
+   *     age_weight: number, frontier_probes: number, max_failures: number,
+   *     state_file: string}} opts Scheduler options. Times are in
+   *     milliseconds and age_weight is per minute.
+   */
+  constructor(opts = {}) {
+    this.interval = opts['interval'] || 0;
+    this.interval_variance = opts['interval_variance'] || 0;
+    this.slow_threshold = opts['slow_threshold'] || 10 * 1000;
+    this.max_backoff = opts['max_backoff'] || 16;
+    this.size_weight = opts['size_weight'] ?? 1;
+    this.age_weight = opts['age_weight'] ?? 1 / 60;
+    this.frontier_probes = opts['frontier_probes'] || 8;
+    this.max_failures = opts['max_failures'] || 5;
+    this.state_file = opts['state_file'];
+
+    this.absent = new Set();
+    // Consecutive failed crawls by ID, skipped once they reach max_failures
+    this.failures = new Map();
+    // IDs past the highest found ID that were not found (yet)
+    this.frontier_misses = new Set();
+    // Sorted by start, each {start, end, first_seen}. The end is inclusive.
+    this.gaps = [];
+    this.heap = new MaxHeap();
+    this.max_found = 0;
+    this.backoff = 1;
+  }
+
+  /**
+   * Loads the state saved by a previous run, if there is one. Fields that are
+   * missing or malformed (e.g. hand-edited or from an older version) are left
+   * empty rather than stopping the crawler.
+   */
+  async load() {
+    if (typeof this.state_file === 'undefined') {
+      return;
+    }
+    let state;
+    try {
+      state = JSON.parse(await fs.promises.readFile(this.state_file, 'utf8'));
+    } catch (e) {
+      if (e.code === 'ENOENT') {
+        return;
+      } else if (e instanceof SyntaxError) {
+        console.error(`Ignoring malformed scheduler state ${this.state_file}`);
+        return;
+      }
+      throw `Error reading scheduler state ${this.state_file}: ${e}`;
+    }
+    if (state === null || typeof state !== 'object') {
+      state = {};
+    }
+
+    const invalid = [];
+    const field = (name, is_valid) => {
+      if (typeof state[name] === 'undefined') {
+        return undefined;
+      } else if (!is_valid(state[name])) {
+        invalid.push(name);
+        return undefined;
+      }
+      return state[name];
+    };
+    const isIDList = (value) =>
+      Array.isArray(value) && value.every(Number.isSafeInteger);
+    const isGapList = (value) =>
+      Array.isArray(value) &&
+      value.every(
+        (gap, idx) =>
+          Array.isArray(gap) &&
+          gap.length === 3 &&
+          gap.every(Number.isSafeInteger) &&
+          gap[0] <= gap[1] &&
+          // Sorted and disjoint, which addGap relies on
+          (idx === 0 || value[idx - 1][1] < gap[0])
+      );
+    const isFailureList = (value) =>
+      Array.isArray(value) &&
+      value.every(
+        (entry) =>
+          Array.isArray(entry) &&
+          entry.length === 2 &&
+          Number.isSafeInteger(entry[0]) &&
+          Number.isSafeInteger(entry[1]) &&
+          entry[1] > 0
+      );
+    const isBackoff = (value) =>
+      typeof value === 'number' && value >= 1 && value <= this.max_backoff;
+
+    this.absent = new Set(field('absent', isIDList));
+    this.frontier_misses = new Set(field('frontier_misses', isIDList));
+    this.failures = new Map(field('failures', isFailureList));
+    this.gaps = (field('gaps', isGapList) || []).map(
+      ([start, end, first_seen]) => ({
+        start: start,
+        end: end,
+        first_seen: first_seen,
+      })
+    );
+    this.backoff = field('backoff', isBackoff) || 1;
+
+    if (invalid.length > 0) {
+      console.error(
+        `Ignoring malformed ${invalid.join(', ')} in scheduler state ` +
+          this.state_file
+      );
+    }
+  }
+
+  /**
+   * Atomically replaces the state file with the current state.
+   */
+  async save() {
+    if (typeof this.state_file === 'undefined') {
+      return;
+    }
+    const state = {
+      absent: Array.from(this.absent),
+      frontier_misses: Array.from(this.frontier_misses),
+      failures: Array.from(this.failures),
+      gaps: this.gaps.map((gap) => [
+        gap['start'],
+        gap['end'],
+        gap['first_seen'],
+      ]),
+      backoff: this.backoff,
+    };
+    const tmp_file = `${this.state_file}.tmp`;
+    await fs.promises.writeFile(tmp_file, JSON.stringify(state));
+    await fs.promises.rename(tmp_file, this.state_file);
+  }
+
+  /**
+   * Recomputes the gaps from the found IDs. Pieces of a gap that was partly
+   * filled keep the age of the gap they came from.
+   * @param {Array<number|string|BigInt>} found_ids The found ids. Values that
+   *     are not integers (e.g. a scraped cell that is not an ID) are ignored.
+   */
+  update(found_ids) {
+    const all_ids = new Float64Array(found_ids.length);
+    let len = 0;
+    for (const found_id of found_ids) {
+      const id = Number(found_id);
+      if (Number.isSafeInteger(id)) {
+        all_ids[len++] = id;
+      }
+    }
+    const ids = all_ids.subarray(0, len).sort();
+    const now = Date.now();
+    const previous = this.gaps;
+    const gaps = [];
+
+    let last = 0;
+    for (let i = 0; i < ids.length; ++i) {
+      const id = ids[i];
+      if (id > last + 1) {
+        this.addGap(gaps, previous, last + 1, id - 1, now);
+      }
+      last = Math.max(last, id);
+    }
+    this.max_found = last;
+    // Frontier misses below a found ID are now ordinary gaps to retry once
+    this.frontier_misses.forEach((id) => {
+      if (id <= last) {
+        this.frontier_misses.delete(id);
+      }
+    });
+
+    this.gaps = gaps;
+    this.heap = new MaxHeap(
+      gaps.map((gap) => ({ gap: gap, score: this.scoreGap(gap, now) }))
+    );
+  }
+
+  /**
+   * Adds [start, end] minus the skipped IDs at its ends to gaps.
+   */
+  addGap(gaps, previous, start, end, now) {
+    while (start <= end && this.isSkipped(start)) {
+      ++start;
+    }
+    while (end >= start && this.isSkipped(end)) {
+      --end;
+    }
+    if (start > end) {
+      return;
+    }
+
+    // The previous gap containing start, found by binary search
+    let lo = 0;
+    let hi = previous.length - 1;
+    let first_seen = now;
+    while (lo <= hi) {
+      const mid = (lo + hi) >> 1;
+      if (previous[mid]['end'] < start) {
+        lo = mid + 1;
+      } else if (previous[mid]['start'] > start) {
+        hi = mid - 1;
+      } else {
+        first_seen = previous[mid]['first_seen'];
+        break;
+      }
+    }
+    gaps.push({ start: start, end: end, first_seen: first_seen });
+  }
+
+  /**
+   * @returns {boolean} Whether the ID is confirmed absent or failed too often
+   */
+  isSkipped(id) {
+    return (
+      this.absent.has(id) || (this.failures.get(id) || 0) >= this.max_failures
+    );
+  }
+
+  scoreGap(gap, now) {
+    const size = gap['end'] - gap['start'] + 1;
+    const age_minutes = (now - gap['first_seen']) / 60000;
+    return (
+      this.size_weight * Math.log2(1 + size) + this.age_weight * age_minutes
+    );
+  }
+
+  /**
+   * Returns the next ID to crawl: the first ID of the best gap that is not
+   * skipped. Once there are no gaps left, probes the IDs past the highest
+   * found ID so a deleted roll there cannot stall the crawl either.
+   * @returns {string}
+   */
+  next() {
+    for (;;) {
+      const item = this.heap.pop();
+      if (typeof item === 'undefined') {
+        return String(this.nextFrontierID());
+      }
+      const gap = item['gap'];
+      for (let id = gap['start']; id <= gap['end']; ++id) {
+        if (!this.isSkipped(id)) {
+          return String(id);
+        }
+      }
+    }
+  }
+
+  nextFrontierID() {
+    for (let k = 1; k <= this.frontier_probes; ++k) {
+      const id = this.max_found + k;
+      if (!this.frontier_misses.has(id) && !this.isSkipped(id)) {
+        return id;
+      }
+    }
+    // Nothing rolled past the highest found ID yet, start probing over
+    this.frontier_misses.clear();
+    let id = this.max_found + 1;
+    while (this.isSkipped(id)) {
+      ++id;
+    }
+    return id;
+  }
+
+  /**
+   * Records that the server has no roll with the ID. IDs past the highest
+   * found ID may simply not have been rolled yet, so they back off and are
+   * only remembered until a higher ID is found.
+   * @param {number|string} id
+   */
+  recordNotFound(id) {
+    id = Number(id);
+    if (!Number.isSafeInteger(id)) {
+      return;
+    }
+    this.failures.delete(id);
+    if (id <= this.max_found) {
+      this.absent.add(id);
+    } else {
+      this.frontier_misses.add(id);
+      this.backoff = Math.min(this.max_backoff, this.backoff * 2);
+    }
+  }
+
+  /**
+   * Backs off while responses are slow and recovers while they are fast.
+   * @param {number} elapsed Milliseconds the crawl took
+   * @param {number|string} id The crawled ID, whose failures are cleared
+   */
+  recordSuccess(elapsed, id) {
+    this.failures.delete(Number(id));
+    if (elapsed > this.slow_threshold) {
+      this.backoff = Math.min(this.max_backoff, this.backoff * 2);
+    } else {
+      this.backoff = Math.max(1, this.backoff / 2);
+    }
+  }
+
+  /**
+   * Backs off and counts the failure against the ID. The ID is skipped once
+   * it failed max_failures times in a row, so a page that always fails (e.g.
+   * an error status or a malformed results table) cannot stall the crawl.
+   * Delete it from the failures in the state file to retry it.
+   * @param {number|string} id The ID whose crawl failed
+   */
+  recordFailure(id) {
+    this.backoff = Math.min(this.max_backoff, this.backoff * 2);
+    id = Number(id);
+    if (!Number.isSafeInteger(id)) {
+      return;
+    }
+    const count = (this.failures.get(id) || 0) + 1;
+    this.failures.set(id, count);
+    if (count === this.max_failures) {
+      console.error(`Skipping ID ${id} after ${count} failed crawls in a row`);
+    }
+  }
+
+  /**
+   * @returns {number} Milliseconds to wait before the next crawl
+   */
+  nextDelay() {
+    const jitter = (Math.random() * 2 - 1) * this.interval_variance;
+    return Math.max(0, (this.interval + jitter) * this.backoff);
+  }
+}
+
+module.exports = {
+  GapScheduler: GapScheduler,
+  MaxHeap: MaxHeap,
+};
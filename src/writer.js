@@ -0,0 +1,234 @@
+const fs = require('fs');
+
+// Durability policies for the batched writer:
+// - none: leave flushing to the OS
+// - batch: fdatasync after every coalesced write
+// - interval: fdatasync files written to every sync_interval milliseconds
+const durability_policies = ['none', 'batch', 'interval'];
+
+/**
+ * Appends DSV chunks to many files while keeping a bounded number of them open.
+ *
+ * Every file has a pending batch and a promise chain. Writes made before the
+ * batch is flushed are coalesced into a single write, and the chain ensures
+ * that batches (and the header) of a file are written in order, even when the
+ * handle is evicted from the LRU cache and re-opened.
+ */
+class BatchedFileWriter {
+  /**
+   * @param {{header: string, max_open_files: number, flush_delay: number,
+   *     durability: string, sync_interval: number}} opts Writer options.
+   *     The header is written first to files that are empty when opened.
+   *     Writes to a file within flush_delay milliseconds of its first pending
+   *     write are coalesced; 0 writes every chunk on the next tick.
+   */
+  constructor(opts = {}) {
+    this.header = opts['header'] || '';
+    this.max_open_files = opts['max_open_files'] || 64;
+    this.flush_delay = opts['flush_delay'] || 0;
+    this.durability = opts['durability'] || 'none';
+    this.sync_interval = opts['sync_interval'] || 1000;
+
+    if (!durability_policies.includes(this.durability)) {
+      throw `Unknown durability policy ${this.durability}`;
+    }
+
+    // Map iterates in insertion order, so re-inserting on use makes the first
+    // key the least recently used file.
+    this.entries = new Map();
+    // Files whose evicted handle is still being flushed and closed
+    this.closing = new Map();
+
+    this.sync_timer = null;
+    if (this.durability === 'interval') {
+      this.sync_timer = setInterval(() => this.sync(), this.sync_interval);
+      this.sync_timer.unref();
+    }
+  }
+
+  /**
+   * Queues data to be appended to the file.
+   * @param {string} file Path of the file to append to
+   * @param {string} data The data to append
+   * @returns {Promise} Resolves once the batch containing the data is written
+   */
+  write(file, data) {
+    const entry = this.acquire(file);
+    entry.pending.push(data);
+
+    const written = new Promise((resolve, reject) => {
+      entry.waiters.push({ resolve: resolve, reject: reject });
+    });
+
+    if (!entry.scheduled) {
+      entry.scheduled = true;
+      entry.timer = setTimeout(() => this.flushEntry(entry), this.flush_delay);
+    }
+    return written;
+  }
+
+  /**
+   * Writes every pending batch.
+   * @returns {Promise} Resolves once all batches queued so far are written
+   */
+  flush() {
+    const chains = [];
+    this.entries.forEach((entry) => {
+      chains.push(this.flushEntry(entry));
+    });
+    return Promise.all(chains);
+  }
+
+  /**
+   * fdatasyncs every open file that was written to since its last sync.
+   * @returns {Promise}
+   */
+  sync() {
+    const chains = [];
+    this.entries.forEach((entry) => {
+      entry.chain = entry.chain
+        .then(() => syncEntry(entry))
+        .catch((err) => console.error(`Error syncing ${entry.file}: `, err));
+      chains.push(entry.chain);
+    });
+    return Promise.all(chains);
+  }
+
+  /**
+   * Flushes, syncs (unless the policy is none) and closes every file.
+   * @returns {Promise}
+   */
+  async close() {
+    if (this.sync_timer !== null) {
+      clearInterval(this.sync_timer);
+      this.sync_timer = null;
+    }
+    const files = Array.from(this.entries.keys());
+    files.forEach((file) => this.evict(file));
+    await Promise.all(Array.from(this.closing.values()));
+  }
+
+  /**
+   * Returns the entry for the file, marking it as most recently used and
+   * evicting the least recently used files past max_open_files.
+   */
+  acquire(file) {
+    let entry = this.entries.get(file);
+    if (typeof entry !== 'undefined') {
+      this.entries.delete(file);
+      this.entries.set(file, entry);
+      return entry;
+    }
+
+    entry = {
+      file: file,
+      handle: null,
+      pending: [],
+      waiters: [],
+      scheduled: false,
+      timer: null,
+      dirty: false,
+      // A re-opened file must wait for its previous handle to be closed
+      chain: this.closing.get(file) || Promise.resolve(),
+    };
+    this.entries.set(file, entry);
+
+    for (const lru_file of this.entries.keys()) {
+      if (this.entries.size <= this.max_open_files) {
+        break;
+      }
+      this.evict(lru_file);
+    }
+    return entry;
+  }
+
+  /**
+   * Removes the file from the cache, then flushes and closes its handle.
+   */
+  evict(file) {
+    const entry = this.entries.get(file);
+    this.entries.delete(file);
+    this.flushEntry(entry);
+
+    const durable = this.durability !== 'none';
+    const closed = entry.chain
+      .then(async () => {
+        if (entry.handle !== null) {
+          if (durable) {
+            await syncEntry(entry);
+          }
+          await entry.handle.close();
+          entry.handle = null;
+        }
+      })
+      .catch((err) => console.error(`Error closing ${file}: `, err))
+      .finally(() => {
+        if (this.closing.get(file) === closed) {
+          this.closing.delete(file);
+        }
+      });
+    this.closing.set(file, closed);
+  }
+
+  /**
+   * Appends the pending batch of the entry to its chain as a single write.
+   * @returns {Promise} The chain of the entry, which never rejects
+   */
+  flushEntry(entry) {
+    clearTimeout(entry.timer);
+    entry.scheduled = false;
+    if (entry.pending.length === 0) {
+      return entry.chain;
+    }
+
+    const chunks = entry.pending;
+    const waiters = entry.waiters;
+    entry.pending = [];
+    entry.waiters = [];
+
+    entry.chain = entry.chain
+      .then(async () => {
+        let data = chunks.join('');
+        if (entry.handle === null) {
+          const handle = await fs.promises.open(entry.file, 'a');
+          // Checked through the handle so no one can create the file between
+          // the check and the header being written.
+          let stats;
+          try {
+            stats = await handle.stat();
+          } catch (err) {
+            // Left closed so the next batch re-opens and checks the file
+            // again instead of skipping its header
+            await handle.close().catch(() => {});
+            throw err;
+          }
+          entry.handle = handle;
+          if (stats.size === 0) {
+            data = this.header + data;
+          }
+        }
+        await entry.handle.write(data);
+        entry.dirty = true;
+        if (this.durability === 'batch') {
+          await syncEntry(entry);
+        }
+      })
+      .then(
+        () => waiters.forEach((waiter) => waiter.resolve()),
+        (err) => waiters.forEach((waiter) => waiter.reject(err))
+      );
+    return entry.chain;
+  }
+}
+
+async function syncEntry(entry) {
+  if (entry.handle !== null && entry.dirty) {
+    entry.dirty = false;
+    await entry.handle.datasync();
+  }
+}
+
+module.exports = {
+  BatchedFileWriter: BatchedFileWriter,
+  durability_policies: durability_policies,
+};